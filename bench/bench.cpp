@@ -0,0 +1,97 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include "bench.hpp"
+
+static volatile double sink;
+void bench::consume(double value)
+{
+    sink = value;
+}
+
+std::vector<wf::touch::gesture_event_t> bench::make_trace(trace_kind_t kind,
+    int cnt_fingers, int steps)
+{
+    static constexpr double RADIUS = 100;
+    std::vector<gesture_event_t> events;
+
+    auto finger_pos = [&] (int finger, int step) -> point_t
+    {
+        const double progress = 1.0 * step / steps;
+        double angle = 2 * M_PI * finger / cnt_fingers;
+        double radius = RADIUS;
+        point_t offset = {500, 500};
+        switch (kind)
+        {
+          case TRACE_SWIPE:
+            offset.x -= 300 * progress;
+            break;
+          case TRACE_PINCH:
+            radius *= 1 + progress;
+            break;
+          case TRACE_ROTATE:
+            angle += M_PI / 2 * progress;
+            break;
+        }
+
+        return offset + radius * point_t{std::cos(angle), std::sin(angle)};
+    };
+
+    uint32_t time = 0;
+    for (int f = 0; f < cnt_fingers; f++)
+    {
+        events.push_back({EVENT_TYPE_TOUCH_DOWN, time, f, finger_pos(f, 0)});
+    }
+
+    for (int step = 1; step <= steps; step++)
+    {
+        time += 4;
+        for (int f = 0; f < cnt_fingers; f++)
+        {
+            events.push_back({EVENT_TYPE_MOTION, time, f, finger_pos(f, step)});
+        }
+    }
+
+    for (int f = 0; f < cnt_fingers; f++)
+    {
+        events.push_back({EVENT_TYPE_TOUCH_UP, time, f, finger_pos(f, steps)});
+    }
+
+    return events;
+}
+
+wf::touch::gesture_t bench::make_gesture(int index, int cnt_fingers)
+{
+    static const uint32_t directions[] = {
+        MOVE_DIRECTION_LEFT, MOVE_DIRECTION_RIGHT, MOVE_DIRECTION_UP, MOVE_DIRECTION_DOWN,
+    };
+
+    gesture_builder_t builder;
+    // vary the finger count, so that not every gesture matches every trace
+    builder.action(touch_action_t(cnt_fingers + (index / 8) % 2, true));
+    switch (index % 8)
+    {
+      case 0:
+      case 1:
+      case 2:
+      case 3:
+        builder.action(drag_action_t(directions[index % 4], 250).set_move_tolerance(150));
+        break;
+      case 4:
+        builder.action(pinch_action_t(1.8).set_move_tolerance(50));
+        break;
+      case 5:
+        builder.action(pinch_action_t(0.5).set_move_tolerance(50));
+        break;
+      case 6:
+        builder.action(rotate_action_t(M_PI / 3).set_move_tolerance(50));
+        break;
+      case 7:
+        builder.action(rotate_action_t(-M_PI / 3).set_move_tolerance(50));
+        break;
+    }
+
+    auto gesture = builder.build();
+    gesture.set_timer(std::make_unique<null_timer_t>());
+    return gesture;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+/**
+ * Shared helpers for the microbenchmarks.
+ *
+ * Each measurement reports the number of heap allocations as well as the time
+ * it took, see allocation-counter.hpp.
+ */
+#include <wayfire/touch/touch.hpp>
+#include "../test/allocation-counter.hpp"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace bench
+{
+using namespace wf::touch;
+
+/** Keep the compiler from optimizing away a computed value. */
+void consume(double value);
+
+/** A timer which never fires and does not allocate. */
+class null_timer_t : public timer_interface_t
+{
+  public:
+    void set_timeout(uint32_t, std::function<void()> handler) override
+    {
+        this->handler = std::move(handler);
+    }
+
+    void reset() override
+    {}
+
+  private:
+    std::function<void()> handler;
+};
+
+/**
+ * Run a workload repeatedly and print the time and allocations per event.
+ *
+ * @param name The name of the measurement.
+ * @param cnt_events The number of events processed by one run of the workload.
+ * @param workload The workload to run.
+ */
+template<class Workload>
+void measure(const char *name, size_t cnt_events, Workload&& workload)
+{
+    using clock = std::chrono::steady_clock;
+    static constexpr auto MIN_DURATION = std::chrono::milliseconds(200);
+
+    // warm up caches and lazily allocated state
+    workload();
+
+    size_t runs = 0;
+    size_t allocations = get_allocation_count();
+    auto start = clock::now();
+    auto end = start;
+    while (end - start < MIN_DURATION)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            workload();
+        }
+
+        runs += 16;
+        end = clock::now();
+    }
+
+    allocations = get_allocation_count() - allocations;
+
+    std::chrono::duration<double, std::nano> elapsed = end - start;
+    const double total_events = 1.0 * runs * cnt_events;
+    std::printf("%-48s %10.2f ns/event %8.3f allocs/event\n", name,
+        elapsed.count() / total_events, allocations / total_events);
+}
+
+enum trace_kind_t
+{
+    TRACE_SWIPE,
+    TRACE_PINCH,
+    TRACE_ROTATE,
+};
+
+/**
+ * Generate a synthetic touch sequence: all fingers touch down on a circle,
+ * move for the given number of steps, and are lifted again.
+ */
+std::vector<gesture_event_t> make_trace(trace_kind_t kind, int cnt_fingers, int steps);
+
+/** Create a gesture which can be recognized from the traces above. */
+gesture_t make_gesture(int index, int cnt_fingers);
+}
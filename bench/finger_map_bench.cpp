@@ -0,0 +1,68 @@
+/**
+ * Compares finger_map_t with the std::map<int, finger_t> it replaced, on the
+ * operations gesture_state_t performs for every event.
+ */
+#include "bench.hpp"
+#include <map>
+
+using namespace wf::touch;
+
+static constexpr int ROUNDS = 200000;
+static constexpr int MOTIONS_PER_ROUND = 16;
+
+template<class Map>
+static void run_round(Map& fingers, int cnt_fingers)
+{
+    for (int i = 0; i < cnt_fingers; i++)
+    {
+        fingers[i].origin  = {1.0 * i, 0};
+        fingers[i].current = {1.0 * i, 0};
+    }
+
+    for (int m = 0; m < MOTIONS_PER_ROUND; m++)
+    {
+        auto it = fingers.find(m % cnt_fingers);
+        it->second.current += point_t{1, 1};
+
+        point_t center = {0, 0};
+        for (auto& f : fingers)
+        {
+            center += f.second.current;
+        }
+
+        bench::consume(center.x);
+    }
+
+    for (int i = 0; i < cnt_fingers; i++)
+    {
+        fingers.erase(i);
+    }
+}
+
+template<class Map>
+static double measure(int cnt_fingers)
+{
+    Map fingers;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        run_round(fingers, cnt_fingers);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::nano> elapsed = end - start;
+    return elapsed.count() / (1.0 * ROUNDS * (2 * cnt_fingers + MOTIONS_PER_ROUND));
+}
+
+int main()
+{
+    std::printf("%8s %16s %16s\n", "fingers", "std::map ns/ev", "finger_map ns/ev");
+    for (int cnt : {1, 2, 3, 5, 10, 20})
+    {
+        double tree = measure<std::map<int, finger_t>>(cnt);
+        double flat = measure<finger_map_t>(cnt);
+        std::printf("%8d %16.2f %16.2f\n", cnt, tree, flat);
+    }
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * Measures full gesture recognition: M gestures fed with traces of N fingers,
+ * either each gesture on its own or all of them through a gesture_set_t or a
+ * gesture_trie_t.
+ * Also compares gesture_t with static_gesture_t for the same swipe gesture.
+ */
+#include "bench.hpp"
+#include <wayfire/touch/gesture-set.hpp>
+#include <wayfire/touch/gesture-trie.hpp>
+#include <wayfire/touch/static-gesture.hpp>
+#include <string>
+
+using namespace bench;
+
+int main()
+{
+    for (auto kind : {TRACE_SWIPE, TRACE_PINCH, TRACE_ROTATE})
+    {
+        static const char *names[] = {"swipe", "pinch", "rotate"};
+        for (int cnt_fingers : {2, 5, 10})
+        {
+            const auto events = make_trace(kind, cnt_fingers, 100);
+            for (int cnt_gestures : {1, 16, 64})
+            {
+                const std::string suffix = std::string(" ") + names[kind] + " " +
+                    std::to_string(cnt_fingers) + "f " + std::to_string(cnt_gestures) + "g";
+
+                std::vector<gesture_t> gestures;
+                gesture_set_t set;
+                gesture_trie_t trie;
+                for (int i = 0; i < cnt_gestures; i++)
+                {
+                    gestures.push_back(make_gesture(i, cnt_fingers));
+                    set.add(make_gesture(i, cnt_fingers));
+                    trie.add(make_gesture(i, cnt_fingers));
+                }
+
+                measure(("gesture_t::update_state" + suffix).c_str(), events.size(), [&] ()
+                {
+                    for (auto& g : gestures)
+                    {
+                        g.reset(0);
+                    }
+
+                    for (auto& ev : events)
+                    {
+                        for (auto& g : gestures)
+                        {
+                            g.update_state(ev);
+                        }
+                    }
+                });
+
+                measure(("gesture_set_t::update_state" + suffix).c_str(), events.size(), [&] ()
+                {
+                    set.reset(0);
+                    set.update_state(events.data(), events.size());
+                });
+
+                measure(("gesture_trie_t::update_state" + suffix).c_str(), events.size(), [&] ()
+                {
+                    trie.reset(0);
+                    for (auto& ev : events)
+                    {
+                        trie.update_state(ev);
+                    }
+                });
+            }
+        }
+    }
+
+    // Taps on one of many targets, like the icons of a launcher
+    for (int cnt_targets : {16, 256, 4096})
+    {
+        static constexpr int TARGET_SIZE = 40;
+        static constexpr int COLUMNS = 64;
+
+        gesture_set_t set;
+        for (int i = 0; i < cnt_targets; i++)
+        {
+            const touch_target_t target = {
+                1.0 * (i % COLUMNS) * TARGET_SIZE, 1.0 * (i / COLUMNS) * TARGET_SIZE,
+                TARGET_SIZE, TARGET_SIZE};
+            set.add(gesture_builder_t()
+                .action(touch_action_t(1, true).set_target(target))
+                .action(touch_action_t(1, false))
+                .build());
+        }
+
+        std::vector<gesture_event_t> events;
+        for (int i = 0; i < 64; i++)
+        {
+            const int tapped = (i * 37) % cnt_targets;
+            const point_t pos = {(tapped % COLUMNS + 0.5) * TARGET_SIZE,
+                (tapped / COLUMNS + 0.5) * TARGET_SIZE};
+            const uint32_t time = i * 100;
+            events.push_back({EVENT_TYPE_TOUCH_DOWN, time, 0, pos});
+            events.push_back({EVENT_TYPE_TOUCH_UP, time + 50, 0, pos});
+        }
+
+        const std::string name = "gesture_set_t tap " + std::to_string(cnt_targets) + " targets";
+        measure(name.c_str(), events.size(), [&] ()
+        {
+            for (size_t i = 0; i < events.size(); i += 2)
+            {
+                set.reset(events[i].time);
+                set.update_state(&events[i], 2);
+            }
+        });
+    }
+
+    for (int cnt_fingers : {2, 5, 10})
+    {
+        const auto events = make_trace(TRACE_SWIPE, cnt_fingers, 100);
+        const std::string suffix = " swipe " + std::to_string(cnt_fingers) + "f";
+
+        auto dynamic = gesture_builder_t()
+            .action(touch_action_t(cnt_fingers, true))
+            .action(drag_action_t(MOVE_DIRECTION_LEFT, 250).set_move_tolerance(150))
+            .build();
+        dynamic.set_timer(std::make_unique<null_timer_t>());
+
+        auto fixed = static_gesture_builder_t<>()
+            .action(touch_action_t(cnt_fingers, true))
+            .action(drag_action_t(MOVE_DIRECTION_LEFT, 250).set_move_tolerance(150))
+            .build();
+        fixed.set_timer(std::make_unique<null_timer_t>());
+
+        measure(("gesture_t" + suffix).c_str(), events.size(), [&] ()
+        {
+            dynamic.reset(0);
+            dynamic.update_state(events.data(), events.size());
+            consume(dynamic.get_progress());
+        });
+
+        measure(("static_gesture_t" + suffix).c_str(), events.size(), [&] ()
+        {
+            fixed.reset(0);
+            fixed.update_state(events.data(), events.size());
+            consume(fixed.get_progress());
+        });
+    }
+
+    return 0;
+}
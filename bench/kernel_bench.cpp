@@ -0,0 +1,128 @@
+/**
+ * Measures the math kernels used by the actions on every event.
+ */
+#include "bench.hpp"
+#include <string>
+
+using namespace bench;
+
+int main()
+{
+    for (auto kind : {TRACE_SWIPE, TRACE_PINCH, TRACE_ROTATE})
+    {
+        static const char *names[] = {"swipe", "pinch", "rotate"};
+        for (int cnt_fingers : {2, 5, 10})
+        {
+            const auto events = make_trace(kind, cnt_fingers, 100);
+            const std::string suffix = std::string(" ") + names[kind] + " " +
+                std::to_string(cnt_fingers) + "f";
+
+            // Replay the trace into a state, querying after every event
+            auto run_query = [&] (const char *name, auto query)
+            {
+                measure((name + suffix).c_str(), events.size(), [&] ()
+                {
+                    gesture_state_t state;
+                    for (auto& ev : events)
+                    {
+                        state.update(ev);
+                        if (!state.fingers.empty())
+                        {
+                            consume(query(state));
+                        }
+                    }
+                });
+            };
+
+            run_query("update", [] (const gesture_state_t&) { return 0.0; });
+            run_query("get_center", [] (const gesture_state_t& s) { return s.get_center().current.x; });
+            run_query("get_pinch_scale", [] (const gesture_state_t& s) { return s.get_pinch_scale(); });
+            run_query("get_rotation_angle", [] (const gesture_state_t& s) { return s.get_rotation_angle(); });
+            run_query("get_max_delta", [] (const gesture_state_t& s) { return s.get_max_delta(); });
+            run_query("finger_t::get_direction", [] (const gesture_state_t& s)
+            {
+                return 1.0 * s.fingers.begin()->second.get_direction();
+            });
+            run_query("finger_t::get_drag_distance", [] (const gesture_state_t& s)
+            {
+                return s.fingers.begin()->second.get_drag_distance(MOVE_DIRECTION_LEFT);
+            });
+            run_query("finger_t::get_incorrect_drag_distance", [] (const gesture_state_t& s)
+            {
+                return s.fingers.begin()->second.get_incorrect_drag_distance(MOVE_DIRECTION_LEFT);
+            });
+        }
+    }
+
+    // The same queries with each instruction set, on large touch tables
+    static const char *levels[] = {"scalar", "sse2", "avx2"};
+    for (auto level : {SIMD_LEVEL_SCALAR, SIMD_LEVEL_SSE2, SIMD_LEVEL_AVX2})
+    {
+        if (level > get_supported_simd_level())
+        {
+            continue;
+        }
+
+        set_simd_level(level);
+        for (int cnt_fingers : {10, 20})
+        {
+            const auto events = make_trace(TRACE_PINCH, cnt_fingers, 100);
+            const std::string suffix = std::string(" ") + levels[level] + " " +
+                std::to_string(cnt_fingers) + "f";
+
+            auto run_query = [&] (const char *name, auto query)
+            {
+                measure((name + suffix).c_str(), events.size(), [&] ()
+                {
+                    gesture_state_t state;
+                    for (auto& ev : events)
+                    {
+                        state.update(ev);
+                        if (!state.fingers.empty())
+                        {
+                            consume(query(state));
+                        }
+                    }
+                });
+            };
+
+            run_query("get_pinch_scale", [] (const gesture_state_t& s) { return s.get_pinch_scale(); });
+            run_query("get_rotation_angle", [] (const gesture_state_t& s) { return s.get_rotation_angle(); });
+            run_query("get_max_delta", [] (const gesture_state_t& s) { return s.get_max_delta(); });
+
+            drag_action_t drag{MOVE_DIRECTION_LEFT, 1e9};
+            drag.set_move_tolerance(1e6);
+            run_query("drag_action_t tolerance", [&] (const gesture_state_t& s)
+            {
+                return 1.0 * drag.update_state(s, {.type = EVENT_TYPE_MOTION});
+            });
+        }
+    }
+
+    set_simd_level(get_supported_simd_level());
+
+    // Predicting all fingers, as a client would once per frame
+    static const char *models[] = {"linear", "kalman"};
+    for (auto model : {PREDICTION_LINEAR, PREDICTION_KALMAN})
+    {
+        for (int cnt_fingers : {2, 10})
+        {
+            const auto events = make_trace(TRACE_SWIPE, cnt_fingers, 100);
+            const std::string name = std::string("get_predicted_center ") + models[model] +
+                " " + std::to_string(cnt_fingers) + "f";
+            measure(name.c_str(), events.size(), [&] ()
+            {
+                gesture_state_t state;
+                state.history.set_capacity(16);
+                state.history.set_prediction(model);
+                for (auto& ev : events)
+                {
+                    state.update(ev);
+                    consume(state.get_predicted_center(ev.time + 16).x);
+                }
+            });
+        }
+    }
+
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include <wayfire/touch/touch.hpp>
 #include <glm/glm.hpp>
+#include "gesture-impl.hpp"
+#include "finger-kernels.hpp"
 
 using namespace wf::touch;
 /* -------------------------- Touch action ---------------------------------- */
@@ -20,20 +22,58 @@ wf::touch::touch_action_t& wf::touch::touch_action_t::set_target(const touch_tar
     return *this;
 }
 
-static double find_max_delta(const gesture_state_t& state)
+int wf::touch::touch_action_t::get_finger_count() const
 {
-    double max_length = 0;
-    for (auto& f : state.fingers)
-    {
-        max_length = std::max(max_length, glm::length(f.second.delta()));
-    }
+    return this->cnt_fingers;
+}
+
+wf::touch::gesture_event_type_t wf::touch::touch_action_t::get_type() const
+{
+    return this->type;
+}
+
+const wf::touch::touch_target_t& wf::touch::touch_action_t::get_target() const
+{
+    return this->target;
+}
+
+bool wf::touch::touch_action_t::operator ==(const touch_action_t& other) const
+{
+    return get_duration() == other.get_duration() &&
+        cnt_fingers == other.cnt_fingers && type == other.type &&
+        move_tolerance == other.move_tolerance &&
+        target.x == other.target.x && target.y == other.target.y &&
+        target.width == other.target.width && target.height == other.target.height;
+}
 
-    return max_length;
+bool wf::touch::touch_action_t::exceeds_tolerance(const gesture_state_t& state) const
+{
+    return state.get_max_delta() > this->move_tolerance;
 }
 
-bool wf::touch::touch_action_t::exceeds_tolerance(const gesture_state_t& state)
+bool wf::touch::touch_action_t::will_never_complete(const gesture_state_t& state) const
 {
-    return find_max_delta(state) > this->move_tolerance;
+    if (exceeds_tolerance(state))
+    {
+        return true;
+    }
+
+    // Fingers which touched down after the action started were checked then.
+    if ((this->type != EVENT_TYPE_TOUCH_DOWN) ||
+        (state.fingers.size() <= (size_t)this->cnt_touch_events))
+    {
+        return false;
+    }
+
+    for (auto& f : state.fingers)
+    {
+        if (!this->target.contains(f.second.origin))
+        {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 void wf::touch::touch_action_t::reset(uint32_t time)
@@ -113,9 +153,20 @@ action_status_t wf::touch::hold_action_t::update_state(const gesture_state_t& st
     }
 }
 
-bool wf::touch::hold_action_t::exceeds_tolerance(const gesture_state_t& state)
+bool wf::touch::hold_action_t::operator ==(const hold_action_t& other) const
 {
-    return find_max_delta(state) > this->move_tolerance;
+    return get_duration() == other.get_duration() &&
+        move_tolerance == other.move_tolerance;
+}
+
+bool wf::touch::hold_action_t::exceeds_tolerance(const gesture_state_t& state) const
+{
+    return state.get_max_delta() > this->move_tolerance;
+}
+
+bool wf::touch::hold_action_t::will_never_complete(const gesture_state_t& state) const
+{
+    return exceeds_tolerance(state);
 }
 
 /*- -------------------------- Drag action ---------------------------------- */
@@ -133,12 +184,13 @@ action_status_t wf::touch::drag_action_t::update_state(const gesture_state_t& st
         return ACTION_STATUS_CANCELLED;
     }
 
-    if (exceeds_tolerance(state))
+    if (exceeds_tolerance_on_update(state))
     {
         return ACTION_STATUS_CANCELLED;
     }
 
     const double dragged = state.get_center().get_drag_distance(this->direction);
+    this->progress = (threshold > 0) ? dragged / threshold : 1.0;
     if (dragged >= this->threshold)
     {
         return ACTION_STATUS_COMPLETED;
@@ -148,19 +200,75 @@ action_status_t wf::touch::drag_action_t::update_state(const gesture_state_t& st
     }
 }
 
-bool wf::touch::drag_action_t::exceeds_tolerance(const gesture_state_t& state)
+bool wf::touch::drag_action_t::operator ==(const drag_action_t& other) const
 {
-    for (auto& f : state.fingers)
+    return get_duration() == other.get_duration() &&
+        threshold == other.threshold && direction == other.direction &&
+        move_tolerance == other.move_tolerance;
+}
+
+bool wf::touch::drag_action_t::exceeds_tolerance(const gesture_state_t& state) const
+{
+    const double tolerance = move_tolerance;
+    return get_finger_kernels().max_incorrect_drag_sq(state.get_finger_arrays(),
+        get_dir_nv(this->direction)) > tolerance * tolerance;
+}
+
+bool wf::touch::drag_action_t::exceeds_tolerance_on_update(const gesture_state_t& state)
+{
+    if (exceeds_tolerance(state))
     {
-        if (f.second.get_incorrect_drag_distance(this->direction) > move_tolerance)
-        {
-            return true;
-        }
+        return true;
     }
 
+    tolerance_checked = state.fingers.version();
     return false;
 }
 
+bool wf::touch::drag_action_t::will_never_complete(const gesture_state_t& state) const
+{
+    // A stale version only skips the check, so the action is not pruned wrongly.
+    return (state.fingers.version() != tolerance_checked) && exceeds_tolerance(state);
+}
+
+/*- -------------------------- Flick action ---------------------------------- */
+wf::touch::flick_action_t::flick_action_t(uint32_t direction, double speed) :
+    drag_action_t(direction, 0)
+{
+    this->speed = speed;
+}
+
+action_status_t wf::touch::flick_action_t::update_state(const gesture_state_t& state,
+    const gesture_event_t& event)
+{
+    if (event.type != EVENT_TYPE_MOTION)
+    {
+        return ACTION_STATUS_CANCELLED;
+    }
+
+    if (exceeds_tolerance_on_update(state))
+    {
+        return ACTION_STATUS_CANCELLED;
+    }
+
+    const point_t normal = get_dir_nv(this->direction);
+    const double current_speed =
+        glm::dot(state.get_center_velocity(), normal) / glm::length(normal);
+    this->progress = (speed > 0) ? current_speed / speed : 1.0;
+    if (current_speed >= this->speed)
+    {
+        return ACTION_STATUS_COMPLETED;
+    } else
+    {
+        return ACTION_STATUS_RUNNING;
+    }
+}
+
+size_t wf::touch::flick_action_t::get_history_size() const
+{
+    return HISTORY_SIZE;
+}
+
 /*- -------------------------- Pinch action ---------------------------------- */
 wf::touch::pinch_action_t::pinch_action_t(double threshold)
 {
@@ -181,6 +289,7 @@ action_status_t wf::touch::pinch_action_t::update_state(const gesture_state_t& s
     }
 
     const double current_scale = state.get_pinch_scale();
+    this->progress = (threshold != 1.0) ? (current_scale - 1.0) / (threshold - 1.0) : 0.0;
     if (((this->threshold < 1.0) && (current_scale <= threshold)) ||
         ((this->threshold > 1.0) && (current_scale >= threshold)))
     {
@@ -190,9 +299,22 @@ action_status_t wf::touch::pinch_action_t::update_state(const gesture_state_t& s
     return ACTION_STATUS_RUNNING;
 }
 
-bool wf::touch::pinch_action_t::exceeds_tolerance(const gesture_state_t& state)
+bool wf::touch::pinch_action_t::operator ==(const pinch_action_t& other) const
+{
+    return get_duration() == other.get_duration() &&
+        threshold == other.threshold && move_tolerance == other.move_tolerance;
+}
+
+bool wf::touch::pinch_action_t::exceeds_tolerance(const gesture_state_t& state) const
 {
-    return glm::length(state.get_center().delta()) > this->move_tolerance;
+    const auto delta = state.get_center().delta();
+    const double tolerance = this->move_tolerance;
+    return glm::dot(delta, delta) > tolerance * tolerance;
+}
+
+bool wf::touch::pinch_action_t::will_never_complete(const gesture_state_t& state) const
+{
+    return exceeds_tolerance(state);
 }
 
 /*- -------------------------- Rotate action ---------------------------------- */
@@ -214,9 +336,10 @@ action_status_t wf::touch::rotate_action_t::update_state(const gesture_state_t&
         return ACTION_STATUS_CANCELLED;
     }
 
-    const double current_scale = state.get_rotation_angle();
-    if (((this->threshold < 0.0) && (current_scale <= threshold)) ||
-        ((this->threshold > 0.0) && (current_scale >= threshold)))
+    const double current_angle = state.get_rotation_angle();
+    this->progress = (threshold != 0.0) ? current_angle / threshold : 0.0;
+    if (((this->threshold < 0.0) && (current_angle <= threshold)) ||
+        ((this->threshold > 0.0) && (current_angle >= threshold)))
     {
         return ACTION_STATUS_COMPLETED;
     }
@@ -224,7 +347,237 @@ action_status_t wf::touch::rotate_action_t::update_state(const gesture_state_t&
     return ACTION_STATUS_RUNNING;
 }
 
-bool wf::touch::rotate_action_t::exceeds_tolerance(const gesture_state_t& state)
+bool wf::touch::rotate_action_t::operator ==(const rotate_action_t& other) const
+{
+    return get_duration() == other.get_duration() &&
+        threshold == other.threshold && move_tolerance == other.move_tolerance;
+}
+
+bool wf::touch::rotate_action_t::exceeds_tolerance(const gesture_state_t& state) const
+{
+    const auto delta = state.get_center().delta();
+    const double tolerance = this->move_tolerance;
+    return glm::dot(delta, delta) > tolerance * tolerance;
+}
+
+bool wf::touch::rotate_action_t::will_never_complete(const gesture_state_t& state) const
+{
+    return exceeds_tolerance(state);
+}
+
+/*- -------------------------- Action groups -------------------------------- */
+size_t wf::touch::action_group_t::size() const
+{
+    return children.size();
+}
+
+size_t wf::touch::action_group_t::get_history_size() const
+{
+    size_t history_size = 0;
+    for (auto& child : children)
+    {
+        history_size = std::max(history_size, get_action(child).get_history_size());
+    }
+
+    return history_size;
+}
+
+void wf::touch::action_group_t::reset_child(size_t idx, uint32_t time)
+{
+    reset_action(children[idx], time);
+    child_start[idx] = time;
+    child_timed_out[idx] = false;
+}
+
+action_status_t wf::touch::action_group_t::expire_child(size_t idx,
+    const gesture_state_t& state, const gesture_event_t& event)
+{
+    auto dur = get_action(children[idx]).get_duration();
+    if (dur && (event.type != EVENT_TYPE_TIMEOUT) && !child_timed_out[idx] &&
+        !time_before(event.time, child_start[idx] + *dur))
+    {
+        child_timed_out[idx] = true;
+        gesture_event_t timeout{.type = EVENT_TYPE_TIMEOUT, .time = child_start[idx] + *dur};
+        return update_action(children[idx], state, timeout);
+    }
+
+    return ACTION_STATUS_RUNNING;
+}
+
+action_status_t wf::touch::action_group_t::update_child(size_t idx,
+    const gesture_state_t& state, const gesture_event_t& event)
+{
+    auto status = expire_child(idx, state, event);
+    if (status != ACTION_STATUS_RUNNING)
+    {
+        return status;
+    }
+
+    return update_action(children[idx], state, event);
+}
+
+void wf::touch::all_of_action_t::reset(uint32_t time)
+{
+    gesture_action_t::reset(time);
+    completed.assign(children.size(), false);
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        reset_child(i, time);
+    }
+}
+
+action_status_t wf::touch::all_of_action_t::update_state(const gesture_state_t& state,
+    const gesture_event_t& event)
+{
+    bool all_completed = true;
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        if (completed[i])
+        {
+            continue;
+        }
+
+        switch (update_child(i, state, event))
+        {
+          case ACTION_STATUS_CANCELLED:
+            return ACTION_STATUS_CANCELLED;
+          case ACTION_STATUS_COMPLETED:
+            completed[i] = true;
+            break;
+          case ACTION_STATUS_RUNNING:
+            all_completed = false;
+            break;
+        }
+    }
+
+    return all_completed ? ACTION_STATUS_COMPLETED : ACTION_STATUS_RUNNING;
+}
+
+bool wf::touch::all_of_action_t::will_never_complete(const gesture_state_t& state) const
+{
+    for (size_t i = 0; i < completed.size(); i++)
+    {
+        if (!completed[i] && get_action(children[i]).will_never_complete(state))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void wf::touch::any_of_action_t::reset(uint32_t time)
+{
+    gesture_action_t::reset(time);
+    cancelled.assign(children.size(), false);
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        reset_child(i, time);
+    }
+}
+
+action_status_t wf::touch::any_of_action_t::update_state(const gesture_state_t& state,
+    const gesture_event_t& event)
+{
+    bool any_running = false;
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        if (cancelled[i])
+        {
+            continue;
+        }
+
+        switch (update_child(i, state, event))
+        {
+          case ACTION_STATUS_COMPLETED:
+            return ACTION_STATUS_COMPLETED;
+          case ACTION_STATUS_CANCELLED:
+            cancelled[i] = true;
+            break;
+          case ACTION_STATUS_RUNNING:
+            any_running = true;
+            break;
+        }
+    }
+
+    return any_running ? ACTION_STATUS_RUNNING : ACTION_STATUS_CANCELLED;
+}
+
+bool wf::touch::any_of_action_t::will_never_complete(const gesture_state_t& state) const
+{
+    for (size_t i = 0; i < cancelled.size(); i++)
+    {
+        if (!cancelled[i] && !get_action(children[i]).will_never_complete(state))
+        {
+            return false;
+        }
+    }
+
+    return !cancelled.empty();
+}
+
+wf::touch::repeat_action_t::repeat_action_t(int count)
+{
+    this->count = count;
+}
+
+void wf::touch::repeat_action_t::reset(uint32_t time)
+{
+    gesture_action_t::reset(time);
+    iteration = 0;
+    current = 0;
+    if (!children.empty())
+    {
+        reset_child(0, time);
+    }
+}
+
+action_status_t wf::touch::repeat_action_t::update_state(const gesture_state_t& state,
+    const gesture_event_t& event)
+{
+    if (children.empty())
+    {
+        return ACTION_STATUS_COMPLETED;
+    }
+
+    while (true)
+    {
+        // Like in a gesture, the next child gets the event if the current
+        // one completes by timing out before it.
+        uint32_t next_start = event.time;
+        auto status = expire_child(current, state, event);
+        const bool timed_out = (status == ACTION_STATUS_COMPLETED);
+        if (timed_out)
+        {
+            next_start = child_start[current] + *get_action(children[current]).get_duration();
+        } else if (status == ACTION_STATUS_RUNNING)
+        {
+            status = update_action(children[current], state, event);
+        }
+
+        if (status != ACTION_STATUS_COMPLETED)
+        {
+            return status;
+        }
+
+        if (++current == children.size())
+        {
+            current = 0;
+            if (++iteration >= count)
+            {
+                return ACTION_STATUS_COMPLETED;
+            }
+        }
+
+        reset_child(current, next_start);
+        if (!timed_out)
+        {
+            return ACTION_STATUS_RUNNING;
+        }
+    }
+}
+
+bool wf::touch::repeat_action_t::will_never_complete(const gesture_state_t& state) const
 {
-    return glm::length(state.get_center().delta()) > this->move_tolerance;
+    return !children.empty() && get_action(children[current]).will_never_complete(state);
 }
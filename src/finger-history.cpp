@@ -0,0 +1,426 @@
+#include <wayfire/touch/touch.hpp>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cassert>
+
+using namespace wf::touch;
+
+namespace
+{
+/** The variance of the measured positions, in squared units. */
+constexpr double POSITION_VARIANCE = 0.25;
+
+/** The variance of the velocity of a finger when it touches down. */
+constexpr double INITIAL_VELOCITY_VARIANCE = 1.0;
+
+/**
+ * The variance of the acceleration of a finger, which the filter models as
+ * white noise, in squared units per ms^4.
+ */
+constexpr double ACCELERATION_VARIANCE = 1e-4;
+
+/** The time window of the line extended by the linear prediction. */
+constexpr uint32_t LINEAR_PREDICTION_WINDOW = 40;
+}
+
+wf::touch::finger_history_t::finger_history_t(const finger_history_t& other)
+{
+    this->capacity = other.capacity;
+    *this = other;
+}
+
+wf::touch::finger_history_t& wf::touch::finger_history_t::operator =(const finger_history_t& other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    model = other.model;
+    prediction_limit = other.prediction_limit;
+
+    if (!other.tracks || (capacity == 0))
+    {
+        // Nothing recorded yet, or nothing to keep
+        if (tracks)
+        {
+            for (size_t i = 0; i < finger_map_t::MAX_FINGERS; i++)
+            {
+                tracks[i] = track_t{};
+            }
+        }
+
+        return *this;
+    }
+
+    if (!tracks)
+    {
+        tracks = std::make_unique<track_t[]>(finger_map_t::MAX_FINGERS);
+        samples = std::make_unique<sample_t[]>(finger_map_t::MAX_FINGERS * capacity);
+    }
+
+    std::copy(other.tracks.get(), other.tracks.get() + finger_map_t::MAX_FINGERS, tracks.get());
+    if (capacity == other.capacity)
+    {
+        std::copy(other.samples.get(), other.samples.get() + finger_map_t::MAX_FINGERS * capacity,
+            samples.get());
+        return *this;
+    }
+
+    // Keep the latest samples of each finger which fit
+    for (size_t i = 0; i < finger_map_t::MAX_FINGERS; i++)
+    {
+        auto& track = tracks[i];
+        const size_t kept = std::min(track.count, capacity);
+        const size_t skipped = track.count - kept;
+        for (size_t j = 0; j < kept; j++)
+        {
+            samples[i * capacity + j] =
+                other.samples[i * other.capacity + (track.first + skipped + j) % other.capacity];
+        }
+
+        track.first = 0;
+        track.count = kept;
+    }
+
+    return *this;
+}
+
+void wf::touch::finger_history_t::set_capacity(size_t samples)
+{
+    assert(samples <= MAX_SAMPLES);
+    this->capacity = samples;
+    this->tracks.reset();
+    this->samples.reset();
+}
+
+size_t wf::touch::finger_history_t::get_capacity() const
+{
+    return capacity;
+}
+
+const finger_history_t::track_t *wf::touch::finger_history_t::find(int finger) const
+{
+    if (!tracks)
+    {
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < finger_map_t::MAX_FINGERS; i++)
+    {
+        if (tracks[i].used && (tracks[i].finger == finger))
+        {
+            return &tracks[i];
+        }
+    }
+
+    return nullptr;
+}
+
+void wf::touch::finger_history_t::record(const gesture_event_t& event)
+{
+    if ((capacity == 0) || (event.type == EVENT_TYPE_TIMEOUT))
+    {
+        return;
+    }
+
+    if (!tracks)
+    {
+        if (event.type != EVENT_TYPE_TOUCH_DOWN)
+        {
+            return;
+        }
+
+        tracks = std::make_unique<track_t[]>(finger_map_t::MAX_FINGERS);
+        samples = std::make_unique<sample_t[]>(finger_map_t::MAX_FINGERS * capacity);
+    }
+
+    auto track = const_cast<track_t*>(find(event.finger));
+    if (event.type == EVENT_TYPE_TOUCH_DOWN)
+    {
+        if (!track)
+        {
+            // A free track, or else the one of the finger lifted first
+            for (size_t i = 0; i < finger_map_t::MAX_FINGERS; i++)
+            {
+                auto& candidate = tracks[i];
+                if (!candidate.used)
+                {
+                    track = &candidate;
+                    break;
+                }
+
+                if (candidate.down)
+                {
+                    continue;
+                }
+
+                auto last_time = [&] (const track_t& t)
+                {
+                    const size_t base = (&t - tracks.get()) * capacity;
+                    return samples[base + (t.first + t.count - 1) % capacity].time;
+                };
+
+                if (!track || (int32_t)(last_time(candidate) - last_time(*track)) < 0)
+                {
+                    track = &candidate;
+                }
+            }
+
+            if (!track)
+            {
+                // Too many fingers
+                return;
+            }
+        }
+
+        *track = track_t{};
+        track->finger = event.finger;
+        track->down = true;
+        track->used = true;
+    }
+
+    if (!track || !track->down)
+    {
+        return;
+    }
+
+    const size_t base = (track - tracks.get()) * capacity;
+    if (track->count == 0)
+    {
+        track->filter_pos = event.pos;
+        track->filter_vel = {0, 0};
+        track->filter_cov[0] = POSITION_VARIANCE;
+        track->filter_cov[1] = 0;
+        track->filter_cov[2] = INITIAL_VELOCITY_VARIANCE;
+    } else
+    {
+        const uint32_t last_time = samples[base + (track->first + track->count - 1) % capacity].time;
+        update_filter(*track, event.time - last_time, event.pos);
+    }
+
+    if (track->count < capacity)
+    {
+        samples[base + (track->first + track->count) % capacity] = {event.time, event.pos};
+        ++track->count;
+    } else
+    {
+        samples[base + track->first] = {event.time, event.pos};
+        track->first = (track->first + 1) % capacity;
+    }
+
+    if (event.type == EVENT_TYPE_TOUCH_UP)
+    {
+        track->down = false;
+    }
+}
+
+void wf::touch::finger_history_t::update_filter(track_t& track, uint32_t dt, point_t pos)
+{
+    auto& cov = track.filter_cov;
+
+    // Move the estimate to the time of the sample
+    const double t = dt;
+    track.filter_pos += track.filter_vel * t;
+    cov[0] += t * (2 * cov[1] + t * cov[2]) + ACCELERATION_VARIANCE * t * t * t * t / 4;
+    cov[1] += t * cov[2] + ACCELERATION_VARIANCE * t * t * t / 2;
+    cov[2] += ACCELERATION_VARIANCE * t * t;
+
+    // Correct it with the measured position
+    const double gain_pos = cov[0] / (cov[0] + POSITION_VARIANCE);
+    const double gain_vel = cov[1] / (cov[0] + POSITION_VARIANCE);
+    const point_t error = pos - track.filter_pos;
+    track.filter_pos += error * gain_pos;
+    track.filter_vel += error * gain_vel;
+    cov[2] -= gain_vel * cov[1];
+    cov[1] *= 1 - gain_pos;
+    cov[0] *= 1 - gain_pos;
+}
+
+size_t wf::touch::finger_history_t::count_samples(int finger) const
+{
+    auto track = find(finger);
+    return track ? track->count : 0;
+}
+
+bool wf::touch::finger_history_t::fit(int finger, uint32_t window, int degree,
+    point_t coefficients[3]) const
+{
+    auto track = find(finger);
+    if (!track || (track->count == 0))
+    {
+        return false;
+    }
+
+    // Sums of the powers of time and of the positions weighted by them, with
+    // the time relative to the last sample.
+    const size_t base = (track - tracks.get()) * capacity;
+    const uint32_t last_time = samples[base + (track->first + track->count - 1) % capacity].time;
+    double t_pow[5] = {0, 0, 0, 0, 0};
+    point_t pos_t_pow[3] = {{0, 0}, {0, 0}, {0, 0}};
+    int cnt_samples = 0;
+    for (size_t i = track->count; i-- > 0;)
+    {
+        auto& sample = samples[base + (track->first + i) % capacity];
+        const uint32_t age = last_time - sample.time;
+        if (age > window)
+        {
+            break;
+        }
+
+        const double t = -1.0 * age;
+        double power = 1;
+        for (int k = 0; k <= 4; k++)
+        {
+            t_pow[k] += power;
+            if (k <= 2)
+            {
+                pos_t_pow[k] += sample.pos * power;
+            }
+
+            power *= t;
+        }
+
+        ++cnt_samples;
+    }
+
+    if (cnt_samples <= degree)
+    {
+        return false;
+    }
+
+    if (degree == 1)
+    {
+        // Least squares line, solving the 2x2 normal equations
+        const double det = t_pow[0] * t_pow[2] - t_pow[1] * t_pow[1];
+        if (det == 0)
+        {
+            // All samples at the same time
+            return false;
+        }
+
+        coefficients[1] = (t_pow[0] * pos_t_pow[1] - t_pow[1] * pos_t_pow[0]) / det;
+        coefficients[0] = (pos_t_pow[0] - coefficients[1] * t_pow[1]) / t_pow[0];
+        return true;
+    }
+
+    // Least squares parabola, solving the 3x3 normal equations by Cramer's rule
+    auto det3 = [] (double a, double b, double c, double d, double e, double f,
+                    double g, double h, double i)
+    {
+        return a * (e * i - f * h) - b * (d * i - f * g) + c * (d * h - e * g);
+    };
+
+    const double *s = t_pow;
+    const double det = det3(s[0], s[1], s[2], s[1], s[2], s[3], s[2], s[3], s[4]);
+    if (det == 0)
+    {
+        return false;
+    }
+
+    for (int axis = 0; axis < 2; axis++)
+    {
+        const double r0 = pos_t_pow[0][axis], r1 = pos_t_pow[1][axis], r2 = pos_t_pow[2][axis];
+        coefficients[0][axis] = det3(r0, s[1], s[2], r1, s[2], s[3], r2, s[3], s[4]) / det;
+        coefficients[1][axis] = det3(s[0], r0, s[2], s[1], r1, s[3], s[2], r2, s[4]) / det;
+        coefficients[2][axis] = det3(s[0], s[1], r0, s[1], s[2], r1, s[2], s[3], r2) / det;
+    }
+
+    return true;
+}
+
+point_t wf::touch::finger_history_t::get_velocity(int finger, uint32_t window) const
+{
+    point_t coefficients[3];
+    if (!fit(finger, window, 1, coefficients))
+    {
+        return {0, 0};
+    }
+
+    return coefficients[1];
+}
+
+point_t wf::touch::finger_history_t::get_acceleration(int finger, uint32_t window) const
+{
+    point_t coefficients[3];
+    if (!fit(finger, window, 2, coefficients))
+    {
+        return {0, 0};
+    }
+
+    return coefficients[2] * 2.0;
+}
+
+void wf::touch::finger_history_t::set_prediction(prediction_model_t model, uint32_t limit)
+{
+    this->model = model;
+    this->prediction_limit = limit;
+}
+
+std::optional<point_t> wf::touch::finger_history_t::predict(int finger, uint32_t time) const
+{
+    auto track = find(finger);
+    if (!track || (track->count == 0))
+    {
+        return {};
+    }
+
+    const size_t base = (track - tracks.get()) * capacity;
+    const auto& last = samples[base + (track->first + track->count - 1) % capacity];
+    const double ahead = std::clamp<int64_t>((int32_t)(time - last.time), 0, prediction_limit);
+    if (model == PREDICTION_KALMAN)
+    {
+        return track->filter_pos + track->filter_vel * ahead;
+    }
+
+    point_t coefficients[3];
+    if (!fit(finger, LINEAR_PREDICTION_WINDOW, 1, coefficients))
+    {
+        return last.pos;
+    }
+
+    return coefficients[0] + coefficients[1] * ahead;
+}
+
+point_t wf::touch::gesture_state_t::get_center_velocity(uint32_t window) const
+{
+    if (fingers.empty())
+    {
+        return {0, 0};
+    }
+
+    point_t sum = {0, 0};
+    for (auto& f : fingers)
+    {
+        sum += history.get_velocity(f.first, window);
+    }
+
+    return sum / (double)fingers.size();
+}
+
+point_t wf::touch::gesture_state_t::get_predicted_position(int finger, uint32_t time) const
+{
+    if (auto predicted = history.predict(finger, time))
+    {
+        return *predicted;
+    }
+
+    auto it = fingers.find(finger);
+    return (it != fingers.end()) ? it->second.current : point_t{0, 0};
+}
+
+point_t wf::touch::gesture_state_t::get_predicted_center(uint32_t time) const
+{
+    if (fingers.empty())
+    {
+        return {0, 0};
+    }
+
+    point_t sum = {0, 0};
+    for (auto& f : fingers)
+    {
+        sum += history.predict(f.first, time).value_or(f.second.current);
+    }
+
+    return sum / (double)fingers.size();
+}
@@ -0,0 +1,448 @@
+#include "finger-kernels.hpp"
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    #define WFTOUCH_X86_KERNELS 1
+    #include <immintrin.h>
+#endif
+
+using namespace wf::touch;
+
+/*
+ * Each kernel processes as many fingers as fit in a vector at once, and the
+ * remaining fingers with the per-finger functions below, which are also the
+ * scalar kernels.
+ */
+namespace
+{
+double delta_sq(const finger_soa_t& f, size_t i)
+{
+    const double dx = f.current_x[i] - f.origin_x[i];
+    const double dy = f.current_y[i] - f.origin_y[i];
+    return dx * dx + dy * dy;
+}
+
+void add_distances(const finger_soa_t& f, size_t i, point_t oc, point_t cc,
+    double& origin_sum, double& current_sum)
+{
+    const double ox = f.origin_x[i] - oc.x, oy = f.origin_y[i] - oc.y;
+    const double cx = f.current_x[i] - cc.x, cy = f.current_y[i] - cc.y;
+    origin_sum += std::sqrt(ox * ox + oy * oy);
+    current_sum += std::sqrt(cx * cx + cy * cy);
+}
+
+void rotation_term(const finger_soa_t& f, size_t i, point_t oc, point_t cc,
+    double *cross, double *dot)
+{
+    const double ox = f.origin_x[i] - oc.x, oy = f.origin_y[i] - oc.y;
+    const double cx = f.current_x[i] - cc.x, cy = f.current_y[i] - cc.y;
+    cross[i] = ox * cy - oy * cx;
+    dot[i] = ox * cx + oy * cy;
+}
+
+double incorrect_drag_sq(const finger_soa_t& f, size_t i, point_t normal)
+{
+    const double dx = f.current_x[i] - f.origin_x[i];
+    const double dy = f.current_y[i] - f.origin_y[i];
+
+    /* grahm-schmidt */
+    const double along = (dx * normal.x + dy * normal.y) / (normal.x * normal.x + normal.y * normal.y);
+    if (along < 0)
+    {
+        /* Drag in opposite direction */
+        return dx * dx + dy * dy;
+    }
+
+    const double rx = dx - normal.x * along;
+    const double ry = dy - normal.y * along;
+    return rx * rx + ry * ry;
+}
+
+/* ------------------------------ Scalar ------------------------------------ */
+double max_delta_sq_scalar(const finger_soa_t& f)
+{
+    double result = 0;
+    for (size_t i = 0; i < f.count; i++)
+    {
+        result = std::max(result, delta_sq(f, i));
+    }
+
+    return result;
+}
+
+void sum_distances_scalar(const finger_soa_t& f, point_t oc, point_t cc,
+    double& origin_sum, double& current_sum)
+{
+    origin_sum = current_sum = 0;
+    for (size_t i = 0; i < f.count; i++)
+    {
+        add_distances(f, i, oc, cc, origin_sum, current_sum);
+    }
+}
+
+void rotation_terms_scalar(const finger_soa_t& f, point_t oc, point_t cc,
+    double *cross, double *dot)
+{
+    for (size_t i = 0; i < f.count; i++)
+    {
+        rotation_term(f, i, oc, cc, cross, dot);
+    }
+}
+
+double max_incorrect_drag_sq_scalar(const finger_soa_t& f, point_t normal)
+{
+    double result = 0;
+    for (size_t i = 0; i < f.count; i++)
+    {
+        result = std::max(result, incorrect_drag_sq(f, i, normal));
+    }
+
+    return result;
+}
+
+const finger_kernels_t scalar_kernels = {
+    max_delta_sq_scalar,
+    sum_distances_scalar,
+    rotation_terms_scalar,
+    max_incorrect_drag_sq_scalar,
+};
+
+#ifdef WFTOUCH_X86_KERNELS
+/* ------------------------------- SSE2 ------------------------------------- */
+__attribute__((target("sse2")))
+double hmax(__m128d v, double result)
+{
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, v);
+    return std::max(std::max(result, lanes[0]), lanes[1]);
+}
+
+__attribute__((target("sse2")))
+double hsum(__m128d v)
+{
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, v);
+    return lanes[0] + lanes[1];
+}
+
+__attribute__((target("sse2")))
+double max_delta_sq_sse2(const finger_soa_t& f)
+{
+    __m128d acc = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= f.count; i += 2)
+    {
+        const __m128d dx = _mm_sub_pd(_mm_load_pd(f.current_x + i), _mm_load_pd(f.origin_x + i));
+        const __m128d dy = _mm_sub_pd(_mm_load_pd(f.current_y + i), _mm_load_pd(f.origin_y + i));
+        const __m128d d2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        // NaN distances are skipped, like with std::max
+        acc = _mm_max_pd(d2, acc);
+    }
+
+    double result = hmax(acc, 0);
+    for (; i < f.count; i++)
+    {
+        result = std::max(result, delta_sq(f, i));
+    }
+
+    return result;
+}
+
+__attribute__((target("sse2")))
+void sum_distances_sse2(const finger_soa_t& f, point_t oc, point_t cc,
+    double& origin_sum, double& current_sum)
+{
+    const __m128d ocx = _mm_set1_pd(oc.x), ocy = _mm_set1_pd(oc.y);
+    const __m128d ccx = _mm_set1_pd(cc.x), ccy = _mm_set1_pd(cc.y);
+    __m128d origin_acc = _mm_setzero_pd(), current_acc = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= f.count; i += 2)
+    {
+        const __m128d ox = _mm_sub_pd(_mm_load_pd(f.origin_x + i), ocx);
+        const __m128d oy = _mm_sub_pd(_mm_load_pd(f.origin_y + i), ocy);
+        const __m128d cx = _mm_sub_pd(_mm_load_pd(f.current_x + i), ccx);
+        const __m128d cy = _mm_sub_pd(_mm_load_pd(f.current_y + i), ccy);
+        origin_acc = _mm_add_pd(origin_acc,
+            _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(ox, ox), _mm_mul_pd(oy, oy))));
+        current_acc = _mm_add_pd(current_acc,
+            _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(cx, cx), _mm_mul_pd(cy, cy))));
+    }
+
+    origin_sum = hsum(origin_acc);
+    current_sum = hsum(current_acc);
+    for (; i < f.count; i++)
+    {
+        add_distances(f, i, oc, cc, origin_sum, current_sum);
+    }
+}
+
+__attribute__((target("sse2")))
+void rotation_terms_sse2(const finger_soa_t& f, point_t oc, point_t cc,
+    double *cross, double *dot)
+{
+    const __m128d ocx = _mm_set1_pd(oc.x), ocy = _mm_set1_pd(oc.y);
+    const __m128d ccx = _mm_set1_pd(cc.x), ccy = _mm_set1_pd(cc.y);
+    size_t i = 0;
+    for (; i + 2 <= f.count; i += 2)
+    {
+        const __m128d ox = _mm_sub_pd(_mm_load_pd(f.origin_x + i), ocx);
+        const __m128d oy = _mm_sub_pd(_mm_load_pd(f.origin_y + i), ocy);
+        const __m128d cx = _mm_sub_pd(_mm_load_pd(f.current_x + i), ccx);
+        const __m128d cy = _mm_sub_pd(_mm_load_pd(f.current_y + i), ccy);
+        _mm_storeu_pd(cross + i, _mm_sub_pd(_mm_mul_pd(ox, cy), _mm_mul_pd(oy, cx)));
+        _mm_storeu_pd(dot + i, _mm_add_pd(_mm_mul_pd(ox, cx), _mm_mul_pd(oy, cy)));
+    }
+
+    for (; i < f.count; i++)
+    {
+        rotation_term(f, i, oc, cc, cross, dot);
+    }
+}
+
+__attribute__((target("sse2")))
+double max_incorrect_drag_sq_sse2(const finger_soa_t& f, point_t normal)
+{
+    const __m128d nx = _mm_set1_pd(normal.x), ny = _mm_set1_pd(normal.y);
+    const __m128d inv_nn = _mm_set1_pd(1.0 / (normal.x * normal.x + normal.y * normal.y));
+    const __m128d zero = _mm_setzero_pd();
+    __m128d acc = zero;
+    size_t i = 0;
+    for (; i + 2 <= f.count; i += 2)
+    {
+        const __m128d dx = _mm_sub_pd(_mm_load_pd(f.current_x + i), _mm_load_pd(f.origin_x + i));
+        const __m128d dy = _mm_sub_pd(_mm_load_pd(f.current_y + i), _mm_load_pd(f.origin_y + i));
+        const __m128d along = _mm_mul_pd(_mm_add_pd(_mm_mul_pd(dx, nx), _mm_mul_pd(dy, ny)), inv_nn);
+        const __m128d rx = _mm_sub_pd(dx, _mm_mul_pd(nx, along));
+        const __m128d ry = _mm_sub_pd(dy, _mm_mul_pd(ny, along));
+
+        const __m128d d2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        const __m128d r2 = _mm_add_pd(_mm_mul_pd(rx, rx), _mm_mul_pd(ry, ry));
+        const __m128d opposite = _mm_cmplt_pd(along, zero);
+        acc = _mm_max_pd(_mm_or_pd(_mm_and_pd(opposite, d2), _mm_andnot_pd(opposite, r2)), acc);
+    }
+
+    double result = hmax(acc, 0);
+    for (; i < f.count; i++)
+    {
+        result = std::max(result, incorrect_drag_sq(f, i, normal));
+    }
+
+    return result;
+}
+
+const finger_kernels_t sse2_kernels = {
+    max_delta_sq_sse2,
+    sum_distances_sse2,
+    rotation_terms_sse2,
+    max_incorrect_drag_sq_sse2,
+};
+
+/* ------------------------------- AVX2 ------------------------------------- */
+/**
+ * Clear the upper halves of the AVX registers before running non-AVX code,
+ * which would otherwise be slowed down by the transitions between them.
+ */
+__attribute__((target("avx2")))
+inline void leave_avx()
+{
+    _mm256_zeroupper();
+}
+
+__attribute__((target("avx2")))
+double hmax(__m256d v, double result)
+{
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, v);
+    leave_avx();
+    for (double lane : lanes)
+    {
+        result = std::max(result, lane);
+    }
+
+    return result;
+}
+
+__attribute__((target("avx2")))
+double hsum(__m256d v)
+{
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, v);
+    leave_avx();
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx2")))
+double max_delta_sq_avx2(const finger_soa_t& f)
+{
+    __m256d acc = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= f.count; i += 4)
+    {
+        const __m256d dx = _mm256_sub_pd(_mm256_load_pd(f.current_x + i), _mm256_load_pd(f.origin_x + i));
+        const __m256d dy = _mm256_sub_pd(_mm256_load_pd(f.current_y + i), _mm256_load_pd(f.origin_y + i));
+        const __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        acc = _mm256_max_pd(d2, acc);
+    }
+
+    double result = hmax(acc, 0);
+    for (; i < f.count; i++)
+    {
+        result = std::max(result, delta_sq(f, i));
+    }
+
+    return result;
+}
+
+__attribute__((target("avx2")))
+void sum_distances_avx2(const finger_soa_t& f, point_t oc, point_t cc,
+    double& origin_sum, double& current_sum)
+{
+    const __m256d ocx = _mm256_set1_pd(oc.x), ocy = _mm256_set1_pd(oc.y);
+    const __m256d ccx = _mm256_set1_pd(cc.x), ccy = _mm256_set1_pd(cc.y);
+    __m256d origin_acc = _mm256_setzero_pd(), current_acc = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= f.count; i += 4)
+    {
+        const __m256d ox = _mm256_sub_pd(_mm256_load_pd(f.origin_x + i), ocx);
+        const __m256d oy = _mm256_sub_pd(_mm256_load_pd(f.origin_y + i), ocy);
+        const __m256d cx = _mm256_sub_pd(_mm256_load_pd(f.current_x + i), ccx);
+        const __m256d cy = _mm256_sub_pd(_mm256_load_pd(f.current_y + i), ccy);
+        origin_acc = _mm256_add_pd(origin_acc,
+            _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(ox, ox), _mm256_mul_pd(oy, oy))));
+        current_acc = _mm256_add_pd(current_acc,
+            _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(cx, cx), _mm256_mul_pd(cy, cy))));
+    }
+
+    origin_sum = hsum(origin_acc);
+    current_sum = hsum(current_acc);
+    for (; i < f.count; i++)
+    {
+        add_distances(f, i, oc, cc, origin_sum, current_sum);
+    }
+}
+
+__attribute__((target("avx2")))
+void rotation_terms_avx2(const finger_soa_t& f, point_t oc, point_t cc,
+    double *cross, double *dot)
+{
+    const __m256d ocx = _mm256_set1_pd(oc.x), ocy = _mm256_set1_pd(oc.y);
+    const __m256d ccx = _mm256_set1_pd(cc.x), ccy = _mm256_set1_pd(cc.y);
+    size_t i = 0;
+    for (; i + 4 <= f.count; i += 4)
+    {
+        const __m256d ox = _mm256_sub_pd(_mm256_load_pd(f.origin_x + i), ocx);
+        const __m256d oy = _mm256_sub_pd(_mm256_load_pd(f.origin_y + i), ocy);
+        const __m256d cx = _mm256_sub_pd(_mm256_load_pd(f.current_x + i), ccx);
+        const __m256d cy = _mm256_sub_pd(_mm256_load_pd(f.current_y + i), ccy);
+        _mm256_storeu_pd(cross + i, _mm256_sub_pd(_mm256_mul_pd(ox, cy), _mm256_mul_pd(oy, cx)));
+        _mm256_storeu_pd(dot + i, _mm256_add_pd(_mm256_mul_pd(ox, cx), _mm256_mul_pd(oy, cy)));
+    }
+
+    leave_avx();
+
+    for (; i < f.count; i++)
+    {
+        rotation_term(f, i, oc, cc, cross, dot);
+    }
+}
+
+__attribute__((target("avx2")))
+double max_incorrect_drag_sq_avx2(const finger_soa_t& f, point_t normal)
+{
+    const __m256d nx = _mm256_set1_pd(normal.x), ny = _mm256_set1_pd(normal.y);
+    const __m256d inv_nn = _mm256_set1_pd(1.0 / (normal.x * normal.x + normal.y * normal.y));
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d acc = zero;
+    size_t i = 0;
+    for (; i + 4 <= f.count; i += 4)
+    {
+        const __m256d dx = _mm256_sub_pd(_mm256_load_pd(f.current_x + i), _mm256_load_pd(f.origin_x + i));
+        const __m256d dy = _mm256_sub_pd(_mm256_load_pd(f.current_y + i), _mm256_load_pd(f.origin_y + i));
+        const __m256d along = _mm256_mul_pd(
+            _mm256_add_pd(_mm256_mul_pd(dx, nx), _mm256_mul_pd(dy, ny)), inv_nn);
+        const __m256d rx = _mm256_sub_pd(dx, _mm256_mul_pd(nx, along));
+        const __m256d ry = _mm256_sub_pd(dy, _mm256_mul_pd(ny, along));
+
+        const __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        const __m256d r2 = _mm256_add_pd(_mm256_mul_pd(rx, rx), _mm256_mul_pd(ry, ry));
+        const __m256d opposite = _mm256_cmp_pd(along, zero, _CMP_LT_OQ);
+        acc = _mm256_max_pd(_mm256_blendv_pd(r2, d2, opposite), acc);
+    }
+
+    double result = hmax(acc, 0);
+    for (; i < f.count; i++)
+    {
+        result = std::max(result, incorrect_drag_sq(f, i, normal));
+    }
+
+    return result;
+}
+
+const finger_kernels_t avx2_kernels = {
+    max_delta_sq_avx2,
+    sum_distances_avx2,
+    rotation_terms_avx2,
+    max_incorrect_drag_sq_avx2,
+};
+#endif
+
+simd_level_t detect_simd_level()
+{
+#ifdef WFTOUCH_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return SIMD_LEVEL_AVX2;
+    }
+
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return SIMD_LEVEL_SSE2;
+    }
+#endif
+
+    return SIMD_LEVEL_SCALAR;
+}
+
+const finger_kernels_t& kernels_for(simd_level_t level)
+{
+    switch (level)
+    {
+#ifdef WFTOUCH_X86_KERNELS
+      case SIMD_LEVEL_AVX2:
+        return avx2_kernels;
+      case SIMD_LEVEL_SSE2:
+        return sse2_kernels;
+#endif
+      default:
+        return scalar_kernels;
+    }
+}
+
+simd_level_t& current_level()
+{
+    static simd_level_t level = detect_simd_level();
+    return level;
+}
+}
+
+wf::touch::simd_level_t wf::touch::get_supported_simd_level()
+{
+    static const simd_level_t supported = detect_simd_level();
+    return supported;
+}
+
+wf::touch::simd_level_t wf::touch::get_simd_level()
+{
+    return current_level();
+}
+
+void wf::touch::set_simd_level(simd_level_t level)
+{
+    current_level() = std::min(level, get_supported_simd_level());
+}
+
+const finger_kernels_t& wf::touch::get_finger_kernels()
+{
+    return kernels_for(current_level());
+}
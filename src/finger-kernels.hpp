@@ -0,0 +1,69 @@
+#pragma once
+
+#include <wayfire/touch/touch.hpp>
+
+namespace wf
+{
+namespace touch
+{
+/**
+ * The math over all fingers needed by the gesture state and the actions.
+ * Distances are returned squared wherever the callers only compare them.
+ */
+struct finger_kernels_t
+{
+    /** @return The largest squared distance of a finger from its origin. */
+    double (*max_delta_sq)(const finger_soa_t& fingers);
+
+    /**
+     * Sum the distances of the origins from origin_center, and of the
+     * current positions from current_center.
+     */
+    void (*sum_distances)(const finger_soa_t& fingers, point_t origin_center,
+        point_t current_center, double& origin_sum, double& current_sum);
+
+    /**
+     * Compute the cross and dot products of the vectors from the centers to
+     * the origin and current position of each finger. The oriented angle
+     * between them is atan2(cross, dot).
+     */
+    void (*rotation_terms)(const finger_soa_t& fingers, point_t origin_center,
+        point_t current_center, double *cross, double *dot);
+
+    /**
+     * @return The largest squared finger_t::get_incorrect_drag_distance() of
+     *   the fingers, for the direction with the given normal vector.
+     */
+    double (*max_incorrect_drag_sq)(const finger_soa_t& fingers, point_t normal);
+};
+
+/** @return The kernels for the level selected by set_simd_level(). */
+const finger_kernels_t& get_finger_kernels();
+
+/** Get normal vector in direction */
+inline point_t get_dir_nv(uint32_t direction)
+{
+    assert((direction != 0) && ((direction & 0b1111) == direction));
+
+    point_t dir = {0, 0};
+    if (direction & MOVE_DIRECTION_LEFT)
+    {
+        dir.x = -1;
+    }
+    else if (direction & MOVE_DIRECTION_RIGHT)
+    {
+        dir.x = 1;
+    }
+    if (direction & MOVE_DIRECTION_UP)
+    {
+        dir.y = -1;
+    }
+    else if (direction & MOVE_DIRECTION_DOWN)
+    {
+        dir.y = 1;
+    }
+
+    return dir;
+}
+}
+}
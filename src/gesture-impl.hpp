@@ -0,0 +1,311 @@
+#pragma once
+
+#include <wayfire/touch/touch.hpp>
+#include "time-util.hpp"
+
+namespace wf
+{
+namespace touch
+{
+/**
+ * Run an action, calling the built-in actions directly instead of through
+ * their vtable. An action which keeps running but will never complete, see
+ * gesture_action_t::will_never_complete(), is reported as cancelled.
+ */
+inline action_status_t update_action(action_storage_t& storage,
+    const gesture_state_t& state, const gesture_event_t& event)
+{
+    return std::visit([&] (auto& action) -> action_status_t
+    {
+        using action_type = std::decay_t<decltype(action)>;
+        action_status_t status;
+        if constexpr (is_inline_action_v<action_type>)
+        {
+            status = action.action_type::update_state(state, event);
+            if ((status == ACTION_STATUS_RUNNING) &&
+                action.action_type::will_never_complete(state))
+            {
+                return ACTION_STATUS_CANCELLED;
+            }
+        } else
+        {
+            status = action->update_state(state, event);
+            if ((status == ACTION_STATUS_RUNNING) && action->will_never_complete(state))
+            {
+                return ACTION_STATUS_CANCELLED;
+            }
+        }
+
+        return status;
+    }, storage);
+}
+
+/** Reset an action, calling the built-in actions directly. */
+inline void reset_action(action_storage_t& storage, uint32_t time)
+{
+    std::visit([&] (auto& action)
+    {
+        using action_type = std::decay_t<decltype(action)>;
+        if constexpr (is_inline_action_v<action_type>)
+        {
+            action.action_type::reset(time);
+        } else
+        {
+            action->reset(time);
+        }
+    }, storage);
+}
+}
+}
+
+/**
+ * The internal state of a gesture_t.
+ * It is shared between the gesture itself and the gesture collections.
+ */
+class wf::touch::gesture_t::impl
+{
+  public:
+    impl(std::pmr::memory_resource *resource) : actions(resource)
+    {}
+
+    gesture_callback_t completed;
+    gesture_callback_t cancelled;
+    gesture_update_callback_t updated;
+
+    /**
+     * Set by a gesture collection which arbitrates the completion of the
+     * gesture. It is called instead of completed(), and the collection calls
+     * completed() or cancelled() once it has decided.
+     */
+    std::function<void()> report_completed;
+
+    /**
+     * Set by a gesture collection which holds back events, to deliver them
+     * before a timeout from the gesture's timer.
+     */
+    std::function<void()> before_timeout;
+
+    /** The conflict group of the gesture in a gesture_set_t, or -1. */
+    int conflict_group = -1;
+    int conflict_priority = 0;
+
+    /**
+     * The position of the gesture in a gesture_set_t, the reset of the set
+     * with which it started waiting for a touch down, and the last touch down
+     * whose point is in the gesture's target.
+     */
+    uint64_t set_order = 0;
+    uint64_t set_reset = 0;
+    uint64_t set_touch = 0;
+
+    std::pmr::vector<action_storage_t> actions;
+    size_t current_action = 0;
+    action_status_t status = ACTION_STATUS_CANCELLED;
+
+    gesture_state_t finger_state;
+
+    /**
+     * The finger state of a gesture collection, updated once per event for
+     * all of its gestures. Until the first action completes, the fingers of
+     * the gesture are the same as the collection's, so the actions run on the
+     * shared state and finger_state is not updated. It is copied from the
+     * shared state when the gesture needs origins of its own.
+     */
+    const gesture_state_t *shared_state = nullptr;
+    bool use_shared = false;
+
+    std::unique_ptr<timer_interface_t> timer;
+
+    /**
+     * When there is no timer, the time at which the current action times out,
+     * checked against the times of incoming events.
+     */
+    std::optional<uint32_t> deadline;
+
+    /** Changes whenever the timer is started or stopped. */
+    uint32_t timer_generation = 0;
+
+    /** Enable the finger history if any of the actions needs it. */
+    void enable_history()
+    {
+        size_t history_size = 0;
+        for (auto& action : actions)
+        {
+            history_size = std::max(history_size, get_action(action).get_history_size());
+        }
+
+        finger_state.history.set_capacity(history_size);
+    }
+
+    void start_gesture(uint32_t time)
+    {
+        status = ACTION_STATUS_RUNNING;
+        use_shared = (shared_state != nullptr);
+        finger_state.fingers.clear();
+        current_action = 0;
+        reset_action(actions[0], time);
+        start_timer(time);
+    }
+
+    void start_timer(uint32_t time)
+    {
+        deadline.reset();
+        const uint32_t generation = ++timer_generation;
+        if (auto dur = get_action(actions[current_action]).get_duration())
+        {
+            if (!timer)
+            {
+                deadline = time + *dur;
+                return;
+            }
+
+            timer->set_timeout(*dur, [=] ()
+            {
+                if (before_timeout)
+                {
+                    // The held back events may complete the action in time
+                    before_timeout();
+                    if (generation != timer_generation)
+                    {
+                        return;
+                    }
+                }
+
+                update_state(gesture_event_t{.type = EVENT_TYPE_TIMEOUT});
+            });
+        }
+    }
+
+    void stop_timer()
+    {
+        ++timer_generation;
+        deadline.reset();
+        if (timer)
+        {
+            timer->reset();
+        }
+    }
+
+    /**
+     * Without a timer, deliver the timeouts of all actions which expire up to
+     * the given time. An action which starts after a timeout may time out as
+     * well.
+     */
+    void expire_deadlines(uint32_t time)
+    {
+        while ((status == ACTION_STATUS_RUNNING) && deadline && !time_before(time, *deadline))
+        {
+            const uint32_t expired = *deadline;
+            deadline.reset();
+            handle_event(gesture_event_t{.type = EVENT_TYPE_TIMEOUT, .time = expired});
+        }
+    }
+
+    /**
+     * Update the gesture with an event.
+     *
+     * While the gesture runs on a shared finger state, the gesture collection
+     * has already applied the event to it, after expiring the deadlines which
+     * come before the event. Otherwise the event is applied to the gesture's
+     * own fingers, like for a gesture on its own. These may still contain
+     * fingers which the shared state dropped when the collection was reset.
+     */
+    void update_state(const gesture_event_t& event)
+    {
+        if (event.type != EVENT_TYPE_TIMEOUT)
+        {
+            expire_deadlines(event.time);
+        }
+
+        if (status != ACTION_STATUS_RUNNING)
+        {
+            // nothing to do
+            return;
+        }
+
+        if (!use_shared)
+        {
+            finger_state.update(event);
+        }
+
+        handle_event(event);
+    }
+
+    /** @return The fingers the actions run on. */
+    const gesture_state_t& get_state() const
+    {
+        return use_shared ? *shared_state : finger_state;
+    }
+
+    /** Continue with a copy of the shared finger state, if it is used. */
+    void detach_shared()
+    {
+        if (use_shared)
+        {
+            finger_state = *shared_state;
+            use_shared = false;
+        }
+    }
+
+    /** Stop the gesture and run the cancelled callback. */
+    void cancel()
+    {
+        this->status = ACTION_STATUS_CANCELLED;
+        stop_timer();
+        cancelled();
+    }
+
+    /** Run the current action on an event already applied to the fingers. */
+    void handle_event(const gesture_event_t& event)
+    {
+        auto& idx = current_action;
+
+        auto next_action = [&] () -> bool
+        {
+            stop_timer();
+            ++idx;
+            if (idx < actions.size())
+            {
+                reset_action(actions[idx], event.time);
+                detach_shared();
+                finger_state.reset_origin();
+                start_timer(event.time);
+                return true;
+            }
+
+            return false;
+        };
+
+        action_status_t pending_status = update_action(actions[idx], get_state(), event);
+        if (updated && (pending_status != ACTION_STATUS_CANCELLED))
+        {
+            updated({idx, get_action(actions[idx]).get_progress(), get_state()});
+        }
+
+        switch (pending_status)
+        {
+          case ACTION_STATUS_RUNNING:
+            return; // nothing more to do
+
+          case ACTION_STATUS_CANCELLED:
+            cancel();
+            return;
+
+          case ACTION_STATUS_COMPLETED:
+            bool has_next = next_action();
+            if (!has_next)
+            {
+                this->status = ACTION_STATUS_COMPLETED;
+                if (report_completed)
+                {
+                    report_completed();
+                } else
+                {
+                    completed();
+                }
+
+                return;
+            }
+        }
+    }
+};
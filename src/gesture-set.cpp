@@ -0,0 +1,575 @@
+#include <wayfire/touch/gesture-set.hpp>
+#include <wayfire/touch/trace.hpp>
+#include "gesture-impl.hpp"
+#include "target-index.hpp"
+#include <algorithm>
+#include <list>
+
+using namespace wf::touch;
+
+class wf::touch::gesture_set_t::impl
+{
+  public:
+    /**
+     * Memory for the gestures built for this set. The pool reuses the memory
+     * of removed gestures, and gets its memory in large blocks from the
+     * arena, so that all gestures are released at once by clear().
+     */
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::unsynchronized_pool_resource pool{&arena};
+
+    std::pmr::list<gesture_t> gestures{&pool};
+
+    /**
+     * The gestures waiting for their first touch action, by the type of the
+     * action. Touch events which cannot match the action cancel the gesture
+     * without evaluating it.
+     */
+    std::vector<gesture_t::impl*> waiting_down;
+    std::vector<gesture_t::impl*> waiting_up;
+
+    /** The targets of the gestures starting with a touch down action. */
+    target_index_t<gesture_t::impl*> targets;
+
+    /**
+     * The waiting gestures whose target contains the current touch down, in
+     * the order in which they were added.
+     */
+    std::vector<gesture_t::impl*> hits;
+
+    /** Counts the gestures added, the resets and the touch downs. */
+    uint64_t cnt_added = 0;
+    uint64_t cnt_resets = 0;
+    uint64_t cnt_touches = 0;
+
+    /** The other gestures which were running after the last event. */
+    std::vector<gesture_t::impl*> active;
+
+    /** Gestures which completed their first action during the current event. */
+    std::vector<gesture_t::impl*> promoted;
+
+    /**
+     * The gestures of conflict groups which completed during the current
+     * event. They are completed or cancelled once all gestures have seen the
+     * event.
+     */
+    std::vector<gesture_t::impl*> contenders;
+    bool dispatching = false;
+
+    gesture_state_t finger_state;
+
+    bool coalesce_motion = false;
+    motion_coalescer_t coalescer;
+    trace_writer_t *recorder = nullptr;
+
+    /** Start tracking a gesture which was just reset. */
+    void activate(gesture_t::impl *gesture)
+    {
+        if (gesture->status != ACTION_STATUS_RUNNING)
+        {
+            return;
+        }
+
+        // gestures which were still running are not restarted by reset()
+        auto touch = std::get_if<touch_action_t>(&gesture->actions[0]);
+        if (touch && (gesture->current_action == 0))
+        {
+            if (touch->get_type() == EVENT_TYPE_TOUCH_DOWN)
+            {
+                gesture->set_reset = cnt_resets;
+                waiting_down.push_back(gesture);
+            } else
+            {
+                waiting_up.push_back(gesture);
+            }
+        } else
+        {
+            active.push_back(gesture);
+        }
+    }
+
+    /**
+     * Update a gesture waiting for its first touch action.
+     *
+     * @return True if the gesture is still waiting.
+     */
+    bool update_waiting(gesture_t::impl *gesture, const gesture_event_t& event)
+    {
+        gesture->update_state(event);
+        if (gesture->status != ACTION_STATUS_RUNNING)
+        {
+            return false;
+        }
+
+        if (gesture->current_action > 0)
+        {
+            promoted.push_back(gesture);
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Update the gestures waiting for a touch action of the given type.
+     * A touch event of the other type cancels the action, so it cancels the
+     * gesture directly.
+     */
+    void dispatch_waiting(std::vector<gesture_t::impl*>& waiting,
+        gesture_event_type_t type, const gesture_event_t& event)
+    {
+        const bool is_touch = (event.type == EVENT_TYPE_TOUCH_DOWN) ||
+            (event.type == EVENT_TYPE_TOUCH_UP);
+
+        size_t kept = 0;
+        for (size_t i = 0; i < waiting.size(); i++)
+        {
+            auto gesture = waiting[i];
+            if ((gesture->status != ACTION_STATUS_RUNNING) || lost_conflict(gesture))
+            {
+                // cancelled by a callback, or by resolve_conflicts()
+                continue;
+            }
+
+            if (is_touch && (event.type != type))
+            {
+                gesture->cancel();
+                continue;
+            }
+
+            if (update_waiting(gesture, event))
+            {
+                waiting[kept++] = gesture;
+            }
+        }
+
+        waiting.resize(kept);
+    }
+
+    /**
+     * Update the gestures waiting for a touch down with a touch down.
+     *
+     * Only the gestures which the target index returns are evaluated. The
+     * others cancel, as a touch down outside of the target cancels the action.
+     */
+    void dispatch_touch_down(const gesture_event_t& event)
+    {
+        const uint64_t touch = ++cnt_touches;
+        hits.clear();
+        targets.query(event.pos, [&] (gesture_t::impl *gesture)
+        {
+            // Gestures which stopped or completed their first action since
+            // the last reset are not waiting anymore
+            if ((gesture->set_reset == cnt_resets) &&
+                (gesture->status == ACTION_STATUS_RUNNING) && (gesture->current_action == 0))
+            {
+                gesture->set_touch = touch;
+                hits.push_back(gesture);
+            }
+        });
+
+        // Conflicts between gestures completing with the same event are won
+        // by the first one, as for the other events
+        std::sort(hits.begin(), hits.end(), [] (gesture_t::impl *a, gesture_t::impl *b)
+        {
+            return a->set_order < b->set_order;
+        });
+
+        for (auto gesture : hits)
+        {
+            if ((gesture->status == ACTION_STATUS_RUNNING) && !lost_conflict(gesture))
+            {
+                update_waiting(gesture, event);
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < waiting_down.size(); i++)
+        {
+            auto gesture = waiting_down[i];
+            if ((gesture->status != ACTION_STATUS_RUNNING) || (gesture->current_action > 0) ||
+                lost_conflict(gesture))
+            {
+                continue;
+            }
+
+            if (gesture->set_touch != touch)
+            {
+                gesture->cancel();
+                continue;
+            }
+
+            waiting_down[kept++] = gesture;
+        }
+
+        waiting_down.resize(kept);
+    }
+
+    /**
+     * Without timers, deliver the timeouts of the running gestures which
+     * expire up to the given time.
+     */
+    void expire_deadlines(uint32_t time)
+    {
+        for (auto waiting : {&waiting_down, &waiting_up})
+        {
+            for (auto& gesture : *waiting)
+            {
+                if (!lost_conflict(gesture))
+                {
+                    gesture->expire_deadlines(time);
+                }
+            }
+        }
+
+        for (auto& gesture : active)
+        {
+            if (!lost_conflict(gesture))
+            {
+                gesture->expire_deadlines(time);
+            }
+        }
+    }
+
+    /** Update the finger state and the running gestures with a single event. */
+    void dispatch(const gesture_event_t& event)
+    {
+        dispatching = true;
+
+        // As for a gesture on its own, the timeouts come before the event,
+        // while the fingers are where they were before it.
+        if (event.type != EVENT_TYPE_TIMEOUT)
+        {
+            expire_deadlines(event.time);
+        }
+
+        finger_state.update(event);
+        if (event.type == EVENT_TYPE_TOUCH_DOWN)
+        {
+            if (!waiting_down.empty())
+            {
+                dispatch_touch_down(event);
+            }
+        } else
+        {
+            dispatch_waiting(waiting_down, EVENT_TYPE_TOUCH_DOWN, event);
+        }
+
+        dispatch_waiting(waiting_up, EVENT_TYPE_TOUCH_UP, event);
+
+        // Callbacks may cancel other gestures, but the list itself is only
+        // modified after all gestures have seen the event.
+        bool any_stopped = false;
+        for (size_t i = 0; i < active.size(); i++)
+        {
+            if (lost_conflict(active[i]))
+            {
+                continue;
+            }
+
+            active[i]->update_state(event);
+            any_stopped |= (active[i]->status != ACTION_STATUS_RUNNING);
+        }
+
+        // These have already seen the event
+        active.insert(active.end(), promoted.begin(), promoted.end());
+        promoted.clear();
+
+        dispatching = false;
+        if (!contenders.empty())
+        {
+            resolve_conflicts();
+            any_stopped = true;
+        }
+
+        if (any_stopped)
+        {
+            active.erase(std::remove_if(active.begin(), active.end(),
+                [] (gesture_t::impl *g) { return g->status != ACTION_STATUS_RUNNING; }),
+                active.end());
+        }
+    }
+
+    /** Called when a gesture in a conflict group completes. */
+    void report_completed(gesture_t::impl *gesture)
+    {
+        contenders.push_back(gesture);
+        if (!dispatching)
+        {
+            // e.g a timeout from the gesture's timer
+            resolve_conflicts();
+        }
+    }
+
+    /**
+     * @return True if a gesture which completed during the current event
+     *   wins over the given gesture, which is then not evaluated anymore.
+     */
+    bool lost_conflict(gesture_t::impl *gesture) const
+    {
+        if (contenders.empty() || (gesture->conflict_group < 0))
+        {
+            return false;
+        }
+
+        return std::any_of(contenders.begin(), contenders.end(),
+            [=] (gesture_t::impl *other)
+        {
+            return (other->conflict_group == gesture->conflict_group) &&
+                (other->conflict_priority >= gesture->conflict_priority);
+        });
+    }
+
+    /**
+     * Complete the winner of each conflict group with contenders, and cancel
+     * the other contenders and running gestures of the group.
+     */
+    void resolve_conflicts()
+    {
+        while (!contenders.empty())
+        {
+            const int group = contenders[0]->conflict_group;
+            auto in_group = [=] (gesture_t::impl *g) { return g->conflict_group == group; };
+
+            gesture_t::impl *winner = contenders[0];
+            for (auto gesture : contenders)
+            {
+                if (in_group(gesture) && (gesture->conflict_priority > winner->conflict_priority))
+                {
+                    winner = gesture;
+                }
+            }
+
+            std::vector<gesture_t::impl*> losers;
+            for (auto& gesture : gestures)
+            {
+                auto member = gesture.priv.get();
+                if ((member != winner) && in_group(member) &&
+                    ((member->status == ACTION_STATUS_RUNNING) ||
+                     (std::find(contenders.begin(), contenders.end(), member) != contenders.end())))
+                {
+                    losers.push_back(member);
+                }
+            }
+
+            contenders.erase(std::remove_if(contenders.begin(), contenders.end(), in_group),
+                contenders.end());
+
+            // The callbacks may change the contenders, so they are called last
+            for (auto loser : losers)
+            {
+                if (loser->status == ACTION_STATUS_RUNNING)
+                {
+                    loser->cancel();
+                } else
+                {
+                    loser->status = ACTION_STATUS_CANCELLED;
+                    loser->cancelled();
+                }
+            }
+
+            winner->completed();
+        }
+    }
+
+    void remove(gesture_t::impl *gesture)
+    {
+        active.erase(std::remove(active.begin(), active.end(), gesture), active.end());
+        for (auto waiting : {&waiting_down, &waiting_up})
+        {
+            waiting->erase(std::remove(waiting->begin(), waiting->end(), gesture),
+                waiting->end());
+        }
+
+        if (auto touch = first_touch_down(gesture))
+        {
+            targets.erase(touch->get_target(), gesture);
+        }
+    }
+
+    /** @return The first action of the gesture if it is a touch down action. */
+    static const touch_action_t *first_touch_down(gesture_t::impl *gesture)
+    {
+        auto touch = std::get_if<touch_action_t>(&gesture->actions[0]);
+        return (touch && (touch->get_type() == EVENT_TYPE_TOUCH_DOWN)) ? touch : nullptr;
+    }
+
+    void clear_running()
+    {
+        active.clear();
+        waiting_down.clear();
+        waiting_up.clear();
+    }
+
+    void flush_motion()
+    {
+        coalescer.flush([=] (const gesture_event_t& ev) { dispatch(ev); });
+    }
+};
+
+wf::touch::gesture_set_t::gesture_set_t()
+{
+    this->priv = std::make_unique<impl>();
+}
+
+wf::touch::gesture_set_t::~gesture_set_t() = default;
+
+wf::touch::gesture_t& wf::touch::gesture_set_t::add(gesture_t&& gesture)
+{
+    assert(!gesture.priv->actions.empty());
+
+    priv->gestures.push_back(std::move(gesture));
+    auto added = priv->gestures.back().priv.get();
+    added->set_order = ++priv->cnt_added;
+    added->shared_state = &priv->finger_state;
+
+    // The shared state keeps as much history as any of the gestures needs
+    auto& history = priv->finger_state.history;
+    const size_t history_size = added->finger_state.history.get_capacity();
+    if (history_size > history.get_capacity())
+    {
+        history.set_capacity(history_size);
+    }
+
+    auto set = priv.get();
+    added->before_timeout = [=] ()
+    {
+        set->flush_motion();
+    };
+
+    if (auto touch = impl::first_touch_down(added))
+    {
+        priv->targets.insert(touch->get_target(), added);
+    }
+
+    return priv->gestures.back();
+}
+
+void wf::touch::gesture_set_t::remove(const gesture_t& gesture)
+{
+    auto it = std::find_if(priv->gestures.begin(), priv->gestures.end(),
+        [&] (const gesture_t& g) { return &g == &gesture; });
+    if (it == priv->gestures.end())
+    {
+        return;
+    }
+
+    priv->remove(it->priv.get());
+    priv->gestures.erase(it);
+}
+
+void wf::touch::gesture_set_t::set_conflict_group(gesture_t& gesture, int group, int priority)
+{
+    auto member = gesture.priv.get();
+    member->conflict_group = group;
+    member->conflict_priority = priority;
+    if (group < 0)
+    {
+        member->report_completed = nullptr;
+        return;
+    }
+
+    auto set = priv.get();
+    member->report_completed = [=] ()
+    {
+        set->report_completed(member);
+    };
+}
+
+void wf::touch::gesture_set_t::clear()
+{
+    priv->clear_running();
+    priv->targets.clear();
+    priv->gestures.clear();
+    priv->pool.release();
+    priv->arena.release();
+}
+
+std::pmr::memory_resource *wf::touch::gesture_set_t::get_arena()
+{
+    return &priv->pool;
+}
+
+size_t wf::touch::gesture_set_t::size() const
+{
+    return priv->gestures.size();
+}
+
+void wf::touch::gesture_set_t::reset(uint32_t time)
+{
+    priv->flush_motion();
+    priv->clear_running();
+    ++priv->cnt_resets;
+    for (auto& gesture : priv->gestures)
+    {
+        // Gestures which are still running keep their fingers
+        if (gesture.priv->status == ACTION_STATUS_RUNNING)
+        {
+            gesture.priv->detach_shared();
+        }
+
+        gesture.reset(time);
+        priv->activate(gesture.priv.get());
+    }
+
+    priv->finger_state.fingers.clear();
+}
+
+void wf::touch::gesture_set_t::update_state(const gesture_event_t& event)
+{
+    update_state(&event, 1);
+}
+
+void wf::touch::gesture_set_t::update_state(const gesture_event_t *events, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (priv->recorder)
+        {
+            priv->recorder->record(events[i]);
+        }
+
+        if (priv->coalesce_motion)
+        {
+            if (priv->coalescer.push(events[i]))
+            {
+                continue;
+            }
+
+            priv->flush_motion();
+        }
+
+        priv->dispatch(events[i]);
+    }
+}
+
+void wf::touch::gesture_set_t::set_coalesce_motion(bool enabled)
+{
+    priv->flush_motion();
+    priv->coalesce_motion = enabled;
+}
+
+void wf::touch::gesture_set_t::advance_time(uint32_t now)
+{
+    // Held back motion happened before the timeouts
+    priv->flush_motion();
+    priv->dispatching = true;
+    priv->expire_deadlines(now);
+    priv->dispatching = false;
+    priv->resolve_conflicts();
+}
+
+void wf::touch::gesture_set_t::set_recorder(trace_writer_t *writer)
+{
+    priv->recorder = writer;
+}
+
+void wf::touch::gesture_set_t::frame()
+{
+    priv->flush_motion();
+}
+
+const wf::touch::gesture_state_t& wf::touch::gesture_set_t::get_state() const
+{
+    return priv->finger_state;
+}
@@ -0,0 +1,347 @@
+#include <wayfire/touch/gesture-trie.hpp>
+#include "gesture-impl.hpp"
+#include <algorithm>
+
+using namespace wf::touch;
+
+namespace
+{
+/** The callbacks of a gesture in the trie. */
+struct leaf_t
+{
+    gesture_callback_t completed;
+    gesture_callback_t cancelled;
+    gesture_update_callback_t updated;
+};
+
+/** An action shared by the gestures on the path to it. */
+struct node_t
+{
+    node_t(action_storage_t action) : action(std::move(action))
+    {}
+
+    action_storage_t action;
+    std::vector<std::unique_ptr<node_t>> children;
+
+    /** The index of the action in the gestures through this node. */
+    size_t depth = 0;
+
+    /** The gestures whose last action is this one. */
+    std::vector<leaf_t> leaves;
+
+    /** The number of gestures through this node with an update callback. */
+    size_t cnt_updated = 0;
+
+    /** The state of the gestures while this action is running. */
+    bool running = false;
+    gesture_state_t finger_state;
+    std::optional<uint32_t> deadline;
+};
+
+/** @return True if both actions are built-in actions configured the same way. */
+bool same_action(const action_storage_t& a, const action_storage_t& b)
+{
+    if (a.index() != b.index())
+    {
+        return false;
+    }
+
+    return std::visit([&] (auto& action) -> bool
+    {
+        using action_type = std::decay_t<decltype(action)>;
+        if constexpr (is_inline_action_v<action_type>)
+        {
+            return action == std::get<action_type>(b);
+        } else
+        {
+            return false;
+        }
+    }, a);
+}
+
+template<class Func>
+void for_each_leaf(node_t *node, Func&& func)
+{
+    for (auto& leaf : node->leaves)
+    {
+        func(leaf);
+    }
+
+    for (auto& child : node->children)
+    {
+        for_each_leaf(child.get(), func);
+    }
+}
+
+/** Run the update callbacks of the gestures through a node. */
+void report_update(node_t *node, const gesture_update_t& update)
+{
+    for (auto& leaf : node->leaves)
+    {
+        if (leaf.updated)
+        {
+            leaf.updated(update);
+        }
+    }
+
+    for (auto& child : node->children)
+    {
+        if (child->cnt_updated > 0)
+        {
+            report_update(child.get(), update);
+        }
+    }
+}
+
+template<class Func>
+void for_each_node(node_t *node, Func&& func)
+{
+    func(node);
+    for (auto& child : node->children)
+    {
+        for_each_node(child.get(), func);
+    }
+}
+}
+
+class wf::touch::gesture_trie_t::impl
+{
+  public:
+    /** The first actions of the gestures. */
+    std::vector<std::unique_ptr<node_t>> roots;
+    size_t cnt_gestures = 0;
+    size_t cnt_actions = 0;
+
+    /** The capacity of the finger history of all nodes. */
+    size_t history_size = 0;
+
+    /** The nodes whose actions are running. */
+    std::vector<node_t*> running;
+    /** The nodes started during the current event. */
+    std::vector<node_t*> started;
+
+    /** Gestures added while recognition was running, merged by reset(). */
+    std::vector<gesture_t> pending;
+
+    void start(node_t *node, uint32_t time, std::vector<node_t*>& into)
+    {
+        node->running = true;
+        reset_action(node->action, time);
+        node->deadline.reset();
+        if (auto dur = get_action(node->action).get_duration())
+        {
+            node->deadline = time + *dur;
+        }
+
+        into.push_back(node);
+    }
+
+    void stop(node_t *node)
+    {
+        node->running = false;
+        node->deadline.reset();
+    }
+
+    /**
+     * Run a node's action on an event already applied to its fingers.
+     * Nodes started because the action completed are added to into.
+     */
+    void handle_event(node_t *node, const gesture_event_t& event, std::vector<node_t*>& into)
+    {
+        const action_status_t status = update_action(node->action, node->finger_state, event);
+        if ((node->cnt_updated > 0) && (status != ACTION_STATUS_CANCELLED))
+        {
+            report_update(node, {node->depth,
+                get_action(node->action).get_progress(), node->finger_state});
+        }
+
+        switch (status)
+        {
+          case ACTION_STATUS_RUNNING:
+            return;
+
+          case ACTION_STATUS_CANCELLED:
+            stop(node);
+            for_each_leaf(node, [] (leaf_t& leaf) { leaf.cancelled(); });
+            return;
+
+          case ACTION_STATUS_COMPLETED:
+            stop(node);
+            for (auto& child : node->children)
+            {
+                child->finger_state = node->finger_state;
+                child->finger_state.reset_origin();
+                start(child.get(), event.time, into);
+            }
+
+            for (auto& leaf : node->leaves)
+            {
+                leaf.completed();
+            }
+
+            return;
+        }
+    }
+
+    void remove_stopped()
+    {
+        running.erase(std::remove_if(running.begin(), running.end(),
+            [] (node_t *node) { return !node->running; }), running.end());
+    }
+
+    /**
+     * Deliver the timeouts which expire up to the given time. Actions started
+     * by a timeout may time out as well.
+     */
+    void expire_deadlines(uint32_t time)
+    {
+        bool any_expired = false;
+        for (size_t i = 0; i < running.size(); i++)
+        {
+            node_t *node = running[i];
+            if (node->running && node->deadline && !time_before(time, *node->deadline))
+            {
+                const uint32_t expired = *node->deadline;
+                node->deadline.reset();
+                handle_event(node, {.type = EVENT_TYPE_TIMEOUT, .time = expired}, running);
+                any_expired = true;
+            }
+        }
+
+        if (any_expired)
+        {
+            remove_stopped();
+        }
+    }
+
+    /** Merge a gesture into the trie. */
+    void attach(gesture_t&& gesture)
+    {
+        // A child copies the state of its parent, so all nodes keep the same
+        // history, as large as the largest any gesture needs.
+        const size_t needed = gesture.priv->finger_state.history.get_capacity();
+        if (needed > history_size)
+        {
+            history_size = needed;
+            for (auto& root : roots)
+            {
+                for_each_node(root.get(), [&] (node_t *n)
+                {
+                    n->finger_state.history.set_capacity(needed);
+                });
+            }
+        }
+
+        const bool has_update = (bool)gesture.priv->updated;
+        auto *level = &roots;
+        node_t *node = nullptr;
+        for (size_t depth = 0; depth < gesture.priv->actions.size(); depth++)
+        {
+            auto& action = gesture.priv->actions[depth];
+            auto it = std::find_if(level->begin(), level->end(),
+                [&] (const std::unique_ptr<node_t>& n) { return same_action(n->action, action); });
+            if (it == level->end())
+            {
+                level->push_back(std::make_unique<node_t>(std::move(action)));
+                level->back()->depth = depth;
+                level->back()->finger_state.history.set_capacity(history_size);
+                ++cnt_actions;
+                it = level->end() - 1;
+            }
+
+            node = it->get();
+            node->cnt_updated += has_update;
+            level = &node->children;
+        }
+
+        node->leaves.push_back({std::move(gesture.priv->completed),
+            std::move(gesture.priv->cancelled), std::move(gesture.priv->updated)});
+        ++cnt_gestures;
+    }
+};
+
+wf::touch::gesture_trie_t::gesture_trie_t()
+{
+    this->priv = std::make_unique<impl>();
+}
+
+wf::touch::gesture_trie_t::~gesture_trie_t() = default;
+
+void wf::touch::gesture_trie_t::add(gesture_t&& gesture)
+{
+    assert(!gesture.priv->actions.empty());
+    if (is_running())
+    {
+        // The running nodes may be shared with the new gesture
+        priv->pending.push_back(std::move(gesture));
+        return;
+    }
+
+    priv->attach(std::move(gesture));
+}
+
+size_t wf::touch::gesture_trie_t::size() const
+{
+    return priv->cnt_gestures + priv->pending.size();
+}
+
+size_t wf::touch::gesture_trie_t::count_actions() const
+{
+    return priv->cnt_actions;
+}
+
+bool wf::touch::gesture_trie_t::is_running() const
+{
+    return !priv->running.empty();
+}
+
+void wf::touch::gesture_trie_t::reset(uint32_t time)
+{
+    if (is_running())
+    {
+        return;
+    }
+
+    for (auto& gesture : priv->pending)
+    {
+        priv->attach(std::move(gesture));
+    }
+
+    priv->pending.clear();
+    for (auto& root : priv->roots)
+    {
+        root->finger_state.fingers.clear();
+        priv->start(root.get(), time, priv->running);
+    }
+}
+
+void wf::touch::gesture_trie_t::update_state(const gesture_event_t& event)
+{
+    if (event.type != EVENT_TYPE_TIMEOUT)
+    {
+        priv->expire_deadlines(event.time);
+    }
+
+    // Nodes started by this event do not see it, like the next action of a
+    // gesture_t.
+    bool any_stopped = false;
+    for (auto node : priv->running)
+    {
+        node->finger_state.update(event);
+        priv->handle_event(node, event, priv->started);
+        any_stopped |= !node->running;
+    }
+
+    if (any_stopped)
+    {
+        priv->remove_stopped();
+    }
+
+    priv->running.insert(priv->running.end(), priv->started.begin(), priv->started.end());
+    priv->started.clear();
+}
+
+void wf::touch::gesture_trie_t::advance_time(uint32_t now)
+{
+    priv->expire_deadlines(now);
+}
@@ -1,9 +1,7 @@
-#define GLM_ENABLE_EXPERIMENTAL // for glm::orientedAngle
-
 #include <wayfire/touch/touch.hpp>
 #include <glm/glm.hpp>
-#include <glm/gtx/vector_angle.hpp>
 #include <cmath>
+#include "finger-kernels.hpp"
 
 #include <iostream>
 #define _ << " " <<
@@ -42,32 +40,6 @@ uint32_t wf::touch::finger_t::get_direction() const
     return result;
 }
 
-/** Get normal vector in direction */
-static point_t get_dir_nv(uint32_t direction)
-{
-    assert((direction != 0) && ((direction & 0b1111) == direction));
-
-    point_t dir = {0, 0};
-    if (direction & MOVE_DIRECTION_LEFT)
-    {
-        dir.x = -1;
-    }
-    else if (direction & MOVE_DIRECTION_RIGHT)
-    {
-        dir.x = 1;
-    }
-    if (direction & MOVE_DIRECTION_UP)
-    {
-        dir.y = -1;
-    }
-    else if (direction & MOVE_DIRECTION_DOWN)
-    {
-        dir.y = 1;
-    }
-
-    return dir;
-}
-
 double wf::touch::finger_t::get_drag_distance(uint32_t direction) const
 {
     const auto normal = get_dir_nv(direction);
@@ -100,35 +72,87 @@ double wf::touch::finger_t::get_incorrect_drag_distance(uint32_t direction) cons
     return glm::length(residual);
 }
 
-double wf::touch::gesture_state_t::get_pinch_scale() const
+bool wf::touch::gesture_state_t::is_cached(cached_value_t value) const
 {
-    auto center = get_center();
-    double old_dist = 0;
-    double new_dist = 0;
+    if (cache_version != fingers.version())
+    {
+        cache_version = fingers.version();
+        cached_values = 0;
+    }
+
+    return cached_values & value;
+}
 
-    for (const auto& f : fingers)
+double wf::touch::gesture_state_t::get_pinch_scale() const
+{
+    if (is_cached(CACHED_PINCH_SCALE))
     {
-        old_dist += glm::length(f.second.origin - center.origin);
-        new_dist += glm::length(f.second.current - center.current);
+        return cached_pinch_scale;
     }
 
+    auto center = get_center();
+    double old_dist;
+    double new_dist;
+    get_finger_kernels().sum_distances(get_finger_arrays(), center.origin, center.current,
+        old_dist, new_dist);
+
     old_dist /= fingers.size();
     new_dist /= fingers.size();
-    return new_dist / old_dist;
+
+    cached_pinch_scale = new_dist / old_dist;
+    cached_values |= CACHED_PINCH_SCALE;
+    return cached_pinch_scale;
 }
 
 double wf::touch::gesture_state_t::get_rotation_angle() const
 {
+    if (fingers.empty())
+    {
+        return 0;
+    }
+
+    if (rotation_version == fingers.version())
+    {
+        return rotation;
+    }
+
+    if (is_cached(CACHED_ROTATION_ANGLE))
+    {
+        return cached_rotation_angle;
+    }
+
     auto center = get_center();
+    double cross[finger_soa_t::CAPACITY];
+    double dot[finger_soa_t::CAPACITY];
+    const finger_soa_t& soa = get_finger_arrays();
+    get_finger_kernels().rotation_terms(soa, center.origin, center.current, cross, dot);
+
+    // The angle of the summed products, as track_rotation() computes it from
+    // the running sums, so that fingers far from the center weigh more than
+    // fingers which barely move around it
+    double cross_sum = 0;
+    double dot_sum = 0;
+    for (size_t i = 0; i < soa.count; i++)
+    {
+        cross_sum += cross[i];
+        dot_sum += dot[i];
+    }
+
+    const double angle = std::atan2(cross_sum, dot_sum);
+    cached_rotation_angle = angle;
+    cached_values |= CACHED_ROTATION_ANGLE;
+    return cached_rotation_angle;
+}
 
-    double angle_sum = 0;
-    for (const auto& f : fingers)
+double wf::touch::gesture_state_t::get_max_delta() const
+{
+    if (is_cached(CACHED_MAX_DELTA))
     {
-        auto v1 = glm::normalize(f.second.origin - center.origin);
-        auto v2 = glm::normalize(f.second.current - center.current);
-        angle_sum += glm::orientedAngle(v1, v2);
+        return cached_max_delta;
     }
 
-    angle_sum /= fingers.size();
-    return angle_sum;
+    // A single sqrt for the largest squared distance
+    cached_max_delta = std::sqrt(get_finger_kernels().max_delta_sq(get_finger_arrays()));
+    cached_values |= CACHED_MAX_DELTA;
+    return cached_max_delta;
 }
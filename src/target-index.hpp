@@ -0,0 +1,215 @@
+#pragma once
+
+#include <wayfire/touch/touch.hpp>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace wf
+{
+namespace touch
+{
+/**
+ * A spatial index over touch targets, answering which targets contain a
+ * point.
+ *
+ * Targets are put in the cells of a uniform grid which they overlap, so a
+ * query only tests the targets of a single cell. Targets which overlap too
+ * many cells, like the edges of a wide output, are put in the rows or the
+ * columns of the grid which they overlap instead, whichever are fewer. Only
+ * targets which are too large in both directions, like the default target of
+ * touch_action_t which covers everything, are kept in a separate list and
+ * tested on every query.
+ */
+template<class Key>
+class target_index_t
+{
+  public:
+    /** The size of a grid cell, in the units of the touch coordinates. */
+    static constexpr double CELL_SIZE = 128;
+    /**
+     * Targets overlapping more cells are not put in the grid, and targets
+     * overlapping more rows and columns are not put in either.
+     */
+    static constexpr int64_t MAX_CELLS = 64;
+
+    void insert(const touch_target_t& target, Key key)
+    {
+        if (!for_each_bucket(target, [&] (buckets_t& buckets, uint64_t bucket)
+        {
+            buckets[bucket].push_back({target, key});
+        }))
+        {
+            large.push_back({target, key});
+        }
+    }
+
+    void erase(const touch_target_t& target, Key key)
+    {
+        auto matches = [=] (const entry_t& entry) { return entry.key == key; };
+        if (!for_each_bucket(target, [&] (buckets_t& buckets, uint64_t bucket)
+        {
+            auto it = buckets.find(bucket);
+            if (it != buckets.end())
+            {
+                auto& entries = it->second;
+                entries.erase(std::remove_if(entries.begin(), entries.end(), matches),
+                    entries.end());
+                if (entries.empty())
+                {
+                    buckets.erase(it);
+                }
+            }
+        }))
+        {
+            large.erase(std::remove_if(large.begin(), large.end(), matches), large.end());
+        }
+    }
+
+    /** @return The number of targets which every query tests. */
+    size_t count_unindexed() const
+    {
+        return large.size();
+    }
+
+    void clear()
+    {
+        grid.clear();
+        rows.clear();
+        columns.clear();
+        large.clear();
+    }
+
+    /** Call func with the key of each target which contains the point. */
+    template<class Func>
+    void query(const point_t& point, Func&& func) const
+    {
+        for (auto& entry : large)
+        {
+            if (entry.target.contains(point))
+            {
+                func(entry.key);
+            }
+        }
+
+        if (!std::isfinite(point.x) || !std::isfinite(point.y))
+        {
+            return;
+        }
+
+        const int64_t cx = cell_coord(point.x);
+        const int64_t cy = cell_coord(point.y);
+        query_bucket(grid, cell_key(cx, cy), point, func);
+        query_bucket(rows, (uint64_t)cy, point, func);
+        query_bucket(columns, (uint64_t)cx, point, func);
+    }
+
+  private:
+    struct entry_t
+    {
+        touch_target_t target;
+        Key key;
+    };
+
+    using buckets_t = std::unordered_map<uint64_t, std::vector<entry_t>>;
+
+    /** Targets by cell, by row of cells and by column of cells. */
+    buckets_t grid;
+    buckets_t rows;
+    buckets_t columns;
+    std::vector<entry_t> large;
+
+    static int64_t cell_coord(double coord)
+    {
+        return (int64_t)std::floor(coord / CELL_SIZE);
+    }
+
+    static uint64_t cell_key(int64_t cx, int64_t cy)
+    {
+        return ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy;
+    }
+
+    template<class Func>
+    static void query_bucket(const buckets_t& buckets, uint64_t bucket,
+        const point_t& point, Func& func)
+    {
+        if (buckets.empty())
+        {
+            return;
+        }
+
+        auto it = buckets.find(bucket);
+        if (it == buckets.end())
+        {
+            return;
+        }
+
+        for (auto& entry : it->second)
+        {
+            if (entry.target.contains(point))
+            {
+                func(entry.key);
+            }
+        }
+    }
+
+    /** @return The first and last cell coordinates of [start, start + size). */
+    static std::pair<int64_t, int64_t> cell_range(double start, double size)
+    {
+        // contains() excludes the right and bottom edges
+        return {cell_coord(start), cell_coord(std::nextafter(start + size, start))};
+    }
+
+    /**
+     * Call func with the buckets and the key of each cell, row or column the
+     * target is put in.
+     *
+     * @return False, without calling func, if the target is too large.
+     */
+    template<class Func>
+    bool for_each_bucket(const touch_target_t& target, Func&& func)
+    {
+        const double cells_x = std::ceil(target.width / CELL_SIZE) + 1;
+        const double cells_y = std::ceil(target.height / CELL_SIZE) + 1;
+        if (cells_x * cells_y <= MAX_CELLS)
+        {
+            const auto [x1, x2] = cell_range(target.x, target.width);
+            const auto [y1, y2] = cell_range(target.y, target.height);
+            for (int64_t cx = x1; cx <= x2; cx++)
+            {
+                for (int64_t cy = y1; cy <= y2; cy++)
+                {
+                    func(grid, cell_key(cx, cy));
+                }
+            }
+
+            return true;
+        }
+
+        if ((cells_y <= MAX_CELLS) && (cells_y <= cells_x))
+        {
+            const auto [y1, y2] = cell_range(target.y, target.height);
+            for (int64_t cy = y1; cy <= y2; cy++)
+            {
+                func(rows, (uint64_t)cy);
+            }
+
+            return true;
+        }
+
+        if (cells_x <= MAX_CELLS)
+        {
+            const auto [x1, x2] = cell_range(target.x, target.width);
+            for (int64_t cx = x1; cx <= x2; cx++)
+            {
+                func(columns, (uint64_t)cx);
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+};
+}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+namespace wf
+{
+namespace touch
+{
+/** @return True if time a is before time b, taking wraparound into account. */
+inline bool time_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+}
+}
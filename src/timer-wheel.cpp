@@ -0,0 +1,341 @@
+#include <wayfire/touch/timer-wheel.hpp>
+#include "time-util.hpp"
+
+using namespace wf::touch;
+
+/*
+ * The wheel has WHEEL_LEVELS levels of WHEEL_SLOTS slots each. A slot on
+ * level L spans WHEEL_SLOTS^L milliseconds. Timers are put on the lowest
+ * level whose range covers their expiry, and moved down a level (cascaded)
+ * when the lower level wraps around.
+ */
+static constexpr int WHEEL_SLOT_BITS = 6;
+static constexpr int WHEEL_SLOTS = 1 << WHEEL_SLOT_BITS;
+static constexpr int WHEEL_LEVELS = 4;
+static constexpr uint32_t WHEEL_MAX_DELAY = (1u << (WHEEL_SLOT_BITS * WHEEL_LEVELS)) - 1;
+
+namespace
+{
+/** A node of the intrusive circular list of timers in a slot. */
+struct link_t
+{
+    link_t *prev = nullptr;
+    link_t *next = nullptr;
+};
+
+uint32_t slot_index(uint32_t time, int level)
+{
+    return (time >> (WHEEL_SLOT_BITS * level)) & (WHEEL_SLOTS - 1);
+}
+}
+
+class wf::touch::timer_wheel_t::timer_t : public timer_interface_t, public link_t
+{
+  public:
+    timer_wheel_t::impl *wheel;
+    std::function<void()> handler;
+    uint32_t expires = 0;
+    /** The time left after expires, for timers beyond the range of the wheel. */
+    uint32_t remaining = 0;
+    int level = 0;
+    int slot = 0;
+
+    timer_t(timer_wheel_t::impl *wheel)
+    {
+        this->wheel = wheel;
+    }
+
+    ~timer_t();
+    void set_timeout(uint32_t msec, std::function<void()> handler) override;
+    void reset() override;
+};
+
+class wf::touch::timer_wheel_t::impl
+{
+  public:
+    link_t slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint64_t occupied[WHEEL_LEVELS] = {};
+    size_t cnt_armed = 0;
+
+    /** The next tick which has not been processed yet. */
+    uint32_t wheel_time;
+    /** Set while running the timers of the tick at wheel_time. */
+    bool running_tick = false;
+    bool advancing = false;
+
+    std::unique_ptr<timer_interface_t> host;
+    std::function<uint32_t()> clock;
+    bool host_armed = false;
+    uint32_t host_deadline = 0;
+
+    impl(std::unique_ptr<timer_interface_t> host, std::function<uint32_t()> clock)
+    {
+        this->host = std::move(host);
+        this->clock = std::move(clock);
+        this->wheel_time = this->clock();
+        for (auto& level : slots)
+        {
+            for (auto& head : level)
+            {
+                head.prev = head.next = &head;
+            }
+        }
+    }
+
+    ~impl()
+    {
+        host->reset();
+    }
+
+    void link(timer_t *timer)
+    {
+        // Timers armed while running a tick expire in the next one at the earliest.
+        const uint32_t earliest = wheel_time + (running_tick ? 1 : 0);
+        if (time_before(timer->expires, earliest))
+        {
+            timer->expires = earliest;
+        }
+
+        // Longer timers are linked again when they reach the end of the range.
+        uint32_t delay = timer->expires - wheel_time;
+        if (delay > WHEEL_MAX_DELAY)
+        {
+            timer->remaining += delay - WHEEL_MAX_DELAY;
+            delay = WHEEL_MAX_DELAY;
+            timer->expires = wheel_time + delay;
+        }
+
+        int level = 0;
+        while ((level < WHEEL_LEVELS - 1) && (delay >> (WHEEL_SLOT_BITS * (level + 1))))
+        {
+            ++level;
+        }
+
+        timer->level = level;
+        timer->slot = slot_index(timer->expires, level);
+
+        link_t& head = slots[level][timer->slot];
+        timer->prev = head.prev;
+        timer->next = &head;
+        head.prev->next = timer;
+        head.prev = timer;
+        occupied[level] |= (1ull << timer->slot);
+        ++cnt_armed;
+    }
+
+    void unlink(timer_t *timer)
+    {
+        if (!timer->prev)
+        {
+            return;
+        }
+
+        timer->prev->next = timer->next;
+        timer->next->prev = timer->prev;
+        timer->prev = timer->next = nullptr;
+
+        link_t& head = slots[timer->level][timer->slot];
+        if (head.next == &head)
+        {
+            occupied[timer->level] &= ~(1ull << timer->slot);
+        }
+
+        --cnt_armed;
+    }
+
+    /** Move the timers of the current slot of a level to the lower levels. */
+    void cascade(int level)
+    {
+        link_t& head = slots[level][slot_index(wheel_time, level)];
+        while (head.next != &head)
+        {
+            auto timer = static_cast<timer_t*>(head.next);
+            unlink(timer);
+            link(timer);
+        }
+    }
+
+    /** Run and remove the timers expiring at wheel_time. */
+    void run_tick()
+    {
+        const uint32_t index = slot_index(wheel_time, 0);
+        if (index == 0)
+        {
+            for (int level = 1; level < WHEEL_LEVELS; level++)
+            {
+                cascade(level);
+                if (slot_index(wheel_time, level) != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        running_tick = true;
+        link_t& head = slots[0][index];
+        while (head.next != &head)
+        {
+            // The handler may arm or reset any timer, including this one.
+            auto timer = static_cast<timer_t*>(head.next);
+            unlink(timer);
+            if (timer->remaining)
+            {
+                timer->expires = wheel_time + timer->remaining;
+                timer->remaining = 0;
+                link(timer);
+                continue;
+            }
+
+            auto handler = std::move(timer->handler);
+            handler();
+        }
+
+        running_tick = false;
+    }
+
+    void advance(uint32_t now)
+    {
+        advancing = true;
+        while (!time_before(now, wheel_time))
+        {
+            if (cnt_armed == 0)
+            {
+                wheel_time = now + 1;
+                break;
+            }
+
+            run_tick();
+
+            // Skip to the next occupied slot of the lowest level, but not past
+            // the point where it wraps around and the higher levels cascade.
+            const uint32_t index = slot_index(wheel_time, 0);
+            const uint64_t later = (index == WHEEL_SLOTS - 1) ?
+                0 : (occupied[0] & (~0ull << (index + 1)));
+            const uint32_t step = later ? (__builtin_ctzll(later) - index) : (WHEEL_SLOTS - index);
+            if ((uint32_t)(now - wheel_time) < step)
+            {
+                wheel_time = now + 1;
+                break;
+            }
+
+            wheel_time += step;
+        }
+
+        advancing = false;
+    }
+
+    /** @return The time at which the wheel needs to run next. */
+    uint32_t next_wakeup() const
+    {
+        uint32_t best = wheel_time + WHEEL_MAX_DELAY;
+        for (int level = 0; level < WHEEL_LEVELS; level++)
+        {
+            if (!occupied[level])
+            {
+                continue;
+            }
+
+            // Rotate the occupied slots so that bit 0 is the current slot.
+            const int shift = WHEEL_SLOT_BITS * level;
+            const uint32_t index = slot_index(wheel_time, level);
+            const uint64_t rotated = index ?
+                ((occupied[level] >> index) | (occupied[level] << (WHEEL_SLOTS - index))) :
+                occupied[level];
+
+            uint32_t candidate;
+            if (level == 0)
+            {
+                candidate = wheel_time + __builtin_ctzll(rotated);
+            } else
+            {
+                // Timers on higher levels are due when their slot is cascaded.
+                // Timers in the current slot wait for a full rotation.
+                const uint64_t ahead = rotated & ~1ull;
+                const uint32_t distance = ahead ? __builtin_ctzll(ahead) : WHEEL_SLOTS;
+                candidate = ((wheel_time >> shift) + distance) << shift;
+            }
+
+            if (time_before(candidate, best))
+            {
+                best = candidate;
+            }
+        }
+
+        return best;
+    }
+
+    /** Make sure the host timer fires in time for the earliest timer. */
+    void arm_host()
+    {
+        if (advancing || (cnt_armed == 0))
+        {
+            return;
+        }
+
+        const uint32_t deadline = next_wakeup();
+        if (host_armed && !time_before(deadline, host_deadline))
+        {
+            return;
+        }
+
+        const uint32_t now = clock();
+        host_armed = true;
+        host_deadline = deadline;
+        host->set_timeout(time_before(now, deadline) ? deadline - now : 0, [=] ()
+        {
+            host_armed = false;
+            advance(clock());
+            arm_host();
+        });
+    }
+};
+
+wf::touch::timer_wheel_t::timer_t::~timer_t()
+{
+    wheel->unlink(this);
+}
+
+void wf::touch::timer_wheel_t::timer_t::set_timeout(uint32_t msec, std::function<void()> handler)
+{
+    wheel->unlink(this);
+    this->handler = std::move(handler);
+    this->remaining = 0;
+    if (msec > WHEEL_MAX_DELAY)
+    {
+        this->remaining = msec - WHEEL_MAX_DELAY;
+        msec = WHEEL_MAX_DELAY;
+    }
+
+    this->expires = wheel->clock() + msec;
+    wheel->link(this);
+    wheel->arm_host();
+}
+
+void wf::touch::timer_wheel_t::timer_t::reset()
+{
+    wheel->unlink(this);
+}
+
+wf::touch::timer_wheel_t::timer_wheel_t(std::unique_ptr<timer_interface_t> host,
+    std::function<uint32_t()> clock)
+{
+    this->priv = std::make_unique<impl>(std::move(host), std::move(clock));
+}
+
+wf::touch::timer_wheel_t::~timer_wheel_t() = default;
+
+std::unique_ptr<timer_interface_t> wf::touch::timer_wheel_t::create_timer()
+{
+    return std::make_unique<timer_t>(priv.get());
+}
+
+void wf::touch::timer_wheel_t::advance(uint32_t now)
+{
+    priv->advance(now);
+    priv->arm_host();
+}
+
+size_t wf::touch::timer_wheel_t::size() const
+{
+    return priv->cnt_armed;
+}
@@ -1,4 +1,9 @@
 #include <wayfire/touch/touch.hpp>
+#include <glm/glm.hpp>
+#include "gesture-impl.hpp"
+#include <typeinfo>
+#include <new>
+#include <cmath>
 
 using namespace wf::touch;
 
@@ -7,47 +12,302 @@ point_t wf::touch::finger_t::delta() const
     return this->current - this->origin;
 }
 
-finger_t wf::touch::gesture_state_t::get_center() const
+finger_t& wf::touch::finger_map_t::operator [](int id)
 {
-    finger_t center;
-    center.origin = {0, 0};
-    center.current = {0, 0};
+    size_t pos = 0;
+    while (pos < used && slots[pos].first < id)
+    {
+        ++pos;
+    }
+
+    if ((pos < used) && (slots[pos].first == id))
+    {
+        ++current_version;
+        return slots[pos].second;
+    }
+
+    assert(!full());
+    if (full())
+    {
+        overflow = finger_t{};
+        return overflow;
+    }
+
+    ++current_version;
+    for (size_t i = used; i > pos; i--)
+    {
+        slots[i] = slots[i - 1];
+    }
+
+    slots[pos] = {id, finger_t{}};
+    ++used;
+    return slots[pos].second;
+}
+
+size_t wf::touch::finger_map_t::erase(int id)
+{
+    size_t pos = lookup(id);
+    if (pos == used)
+    {
+        return 0;
+    }
+
+    ++current_version;
+    for (size_t i = pos + 1; i < used; i++)
+    {
+        slots[i - 1] = slots[i];
+    }
+
+    --used;
+    return 1;
+}
+
+/** @return The z component of the cross product of two vectors. */
+static double cross(point_t a, point_t b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+void wf::touch::gesture_state_t::resync_sums() const
+{
+    origin_sum = {0, 0};
+    current_sum = {0, 0};
+    cross_sum = 0;
+    dot_sum = 0;
+    for (auto& f : this->fingers)
+    {
+        origin_sum += f.second.origin;
+        current_sum += f.second.current;
+        cross_sum += cross(f.second.origin, f.second.current);
+        dot_sum += glm::dot(f.second.origin, f.second.current);
+    }
+
+    sums_version = fingers.version();
+    sums_updates = 0;
+}
+
+/** Store a finger at the given index of the arrays. */
+static void set_arrays(finger_soa_t& arrays, size_t i, const finger_t& finger)
+{
+    arrays.origin_x[i] = finger.origin.x;
+    arrays.origin_y[i] = finger.origin.y;
+    arrays.current_x[i] = finger.current.x;
+    arrays.current_y[i] = finger.current.y;
+}
+
+/** Insert a finger at the given index of the arrays. */
+static void insert_arrays(finger_soa_t& arrays, size_t i, const finger_t& finger)
+{
+    for (double *column : {arrays.origin_x, arrays.origin_y, arrays.current_x, arrays.current_y})
+    {
+        std::copy_backward(column + i, column + arrays.count, column + arrays.count + 1);
+    }
+
+    ++arrays.count;
+    set_arrays(arrays, i, finger);
+}
+
+/** Remove the finger at the given index of the arrays. */
+static void erase_arrays(finger_soa_t& arrays, size_t i)
+{
+    for (double *column : {arrays.origin_x, arrays.origin_y, arrays.current_x, arrays.current_y})
+    {
+        std::copy(column + i + 1, column + arrays.count, column + i);
+    }
 
+    --arrays.count;
+}
+
+void wf::touch::gesture_state_t::resync_arrays() const
+{
+    arrays.count = 0;
     for (auto& f : this->fingers)
     {
-        center.origin += f.second.origin;
-        center.current += f.second.current;
+        set_arrays(arrays, arrays.count++, f.second);
+    }
+
+    arrays_version = fingers.version();
+}
+
+const finger_soa_t& wf::touch::gesture_state_t::get_finger_arrays() const
+{
+    if (arrays_version != fingers.version())
+    {
+        resync_arrays();
     }
 
-    center.origin /= this->fingers.size();
-    center.current /= this->fingers.size();
+    return arrays;
+}
+
+finger_t wf::touch::gesture_state_t::get_center() const
+{
+    if (sums_version != fingers.version())
+    {
+        resync_sums();
+    }
+
+    finger_t center;
+    center.origin = origin_sum / (double)this->fingers.size();
+    center.current = current_sum / (double)this->fingers.size();
     return center;
 }
 
+void wf::touch::gesture_state_t::track_rotation()
+{
+    if (fingers.size() < 2)
+    {
+        // A single finger does not rotate around itself
+        return;
+    }
+
+    // The sums of the cross and dot products of the vectors from the centers
+    // to the origin and current position of each finger
+    const double count = fingers.size();
+    const double cross_centered = cross_sum - cross(origin_sum, current_sum) / count;
+    const double dot_centered = dot_sum - glm::dot(origin_sum, current_sum) / count;
+
+    // The angle changes by much less than a half turn between two events, so
+    // the change can be taken in [-pi, pi] to unwrap it.
+    const double angle = std::atan2(cross_centered, dot_centered);
+    rotation += std::remainder(angle - rotation, 2 * M_PI);
+}
+
 void wf::touch::gesture_state_t::update(const gesture_event_t& event)
 {
+    if (sums_version != fingers.version())
+    {
+        // The fingers were modified directly
+        resync_sums();
+    }
+
+    if (arrays_version != fingers.version())
+    {
+        resync_arrays();
+    }
+
+    const bool rotation_valid = fingers.empty() || (rotation_version == fingers.version());
     switch (event.type)
     {
       case EVENT_TYPE_TOUCH_DOWN:
-        fingers[event.finger].origin = event.pos;
-        // fallthrough
+      {
+        auto it = fingers.find(event.finger);
+        if (it != fingers.end())
+        {
+            origin_sum -= it->second.origin;
+            current_sum -= it->second.current;
+            cross_sum -= cross(it->second.origin, it->second.current);
+            dot_sum -= glm::dot(it->second.origin, it->second.current);
+            it->second = finger_t{event.pos, event.pos};
+            fingers.mark_modified();
+            set_arrays(arrays, it - fingers.begin(), it->second);
+        } else if (!fingers.full())
+        {
+            fingers[event.finger] = finger_t{event.pos, event.pos};
+            insert_arrays(arrays, fingers.find(event.finger) - fingers.begin(),
+                finger_t{event.pos, event.pos});
+        } else
+        {
+            break;
+        }
+
+        origin_sum += event.pos;
+        current_sum += event.pos;
+        dot_sum += glm::dot(event.pos, event.pos);
+        break;
+      }
+
       case EVENT_TYPE_MOTION:
-        fingers[event.finger].current = event.pos;
+      {
+        auto it = fingers.find(event.finger);
+        if (it != fingers.end())
+        {
+            const point_t delta = event.pos - it->second.current;
+            current_sum += delta;
+            cross_sum += cross(it->second.origin, delta);
+            dot_sum += glm::dot(it->second.origin, delta);
+            it->second.current = event.pos;
+            fingers.mark_modified();
+            arrays.current_x[it - fingers.begin()] = event.pos.x;
+            arrays.current_y[it - fingers.begin()] = event.pos.y;
+        }
+
         break;
+      }
+
       case EVENT_TYPE_TOUCH_UP:
-        fingers.erase(event.finger);
+      {
+        auto it = fingers.find(event.finger);
+        if (it != fingers.end())
+        {
+            origin_sum -= it->second.origin;
+            current_sum -= it->second.current;
+            cross_sum -= cross(it->second.origin, it->second.current);
+            dot_sum -= glm::dot(it->second.origin, it->second.current);
+            erase_arrays(arrays, it - fingers.begin());
+            fingers.erase(event.finger);
+        }
+
         break;
+      }
+
       default:
         break;
     }
+
+    arrays_version = fingers.version();
+    if (rotation_valid)
+    {
+        track_rotation();
+        rotation_version = fingers.version();
+    }
+
+    if (fingers.empty())
+    {
+        origin_sum = {0, 0};
+        current_sum = {0, 0};
+        cross_sum = 0;
+        dot_sum = 0;
+        sums_updates = 0;
+        sums_version = fingers.version();
+        rotation = 0;
+    } else if (++sums_updates < SUMS_RESYNC_INTERVAL)
+    {
+        sums_version = fingers.version();
+    }
+
+    history.record(event);
 }
 
 void wf::touch::gesture_state_t::reset_origin()
 {
+    const bool sums_valid = (sums_version == fingers.version());
+    const bool arrays_valid = (arrays_version == fingers.version());
+    double sq_sum = 0;
     for (auto& f : fingers)
     {
         f.second.origin = f.second.current;
+        sq_sum += glm::dot(f.second.current, f.second.current);
+    }
+
+    fingers.mark_modified();
+
+    if (sums_valid)
+    {
+        origin_sum = current_sum;
+        cross_sum = 0;
+        dot_sum = sq_sum;
+        sums_version = fingers.version();
     }
+
+    if (arrays_valid)
+    {
+        std::copy(arrays.current_x, arrays.current_x + arrays.count, arrays.origin_x);
+        std::copy(arrays.current_y, arrays.current_y + arrays.count, arrays.origin_y);
+        arrays_version = fingers.version();
+    }
+
+    rotation = 0;
+    rotation_version = fingers.version();
 }
 
 wf::touch::gesture_action_t& wf::touch::gesture_action_t::set_duration(uint32_t duration)
@@ -61,9 +321,15 @@ std::optional<uint32_t> wf::touch::gesture_action_t::get_duration() const
     return this->duration;
 }
 
+double wf::touch::gesture_action_t::get_progress() const
+{
+    return this->progress;
+}
+
 void wf::touch::gesture_action_t::reset(uint32_t time)
 {
     this->start_time = time;
+    this->progress = 0.0;
 }
 
 bool wf::touch::touch_target_t::contains(const point_t& pt) const
@@ -72,103 +338,107 @@ bool wf::touch::touch_target_t::contains(const point_t& pt) const
         y <= pt.y && pt.y < y + height;
 }
 
-class wf::touch::gesture_t::impl
+void wf::touch::gesture_t::set_timer(std::unique_ptr<timer_interface_t> timer)
 {
-  public:
-    gesture_callback_t completed;
-    gesture_callback_t cancelled;
-
-    std::vector<std::unique_ptr<gesture_action_t>> actions;
-    size_t current_action = 0;
-    action_status_t status = ACTION_STATUS_CANCELLED;
-
-    gesture_state_t finger_state;
-    std::unique_ptr<timer_interface_t> timer;
+    priv->timer = std::move(timer);
+}
 
-    void start_gesture(uint32_t time)
-    {
-        status = ACTION_STATUS_RUNNING;
-        finger_state.fingers.clear();
-        current_action = 0;
-        actions[0]->reset(time);
-        start_timer();
-    }
+void wf::touch::gesture_t::set_update_callback(gesture_update_callback_t callback)
+{
+    priv->updated = std::move(callback);
+}
 
-    void start_timer()
+wf::touch::gesture_action_t& wf::touch::get_action(action_storage_t& storage)
+{
+    return std::visit([] (auto& action) -> gesture_action_t&
     {
-        if (auto dur = actions[current_action]->get_duration())
+        using action_type = std::decay_t<decltype(action)>;
+        if constexpr (is_inline_action_v<action_type>)
+        {
+            return action;
+        } else
         {
-            timer->set_timeout(*dur, [=] ()
-            {
-                update_state(gesture_event_t{.type = EVENT_TYPE_TIMEOUT});
-            });
+            return *action;
         }
+    }, storage);
+}
+
+const wf::touch::gesture_action_t& wf::touch::get_action(const action_storage_t& storage)
+{
+    return get_action(const_cast<action_storage_t&>(storage));
+}
+
+/**
+ * Move an action to inline storage if it is exactly one of the built-in
+ * actions, and keep it behind its pointer otherwise.
+ */
+template<class ActionType, class... Rest>
+static action_storage_t to_storage(std::unique_ptr<gesture_action_t>& action)
+{
+    if (typeid(*action) == typeid(ActionType))
+    {
+        return action_storage_t{std::in_place_type<ActionType>,
+            std::move(static_cast<ActionType&>(*action))};
     }
 
-    void update_state(const gesture_event_t& event)
+    if constexpr (sizeof...(Rest) > 0)
     {
-        if (status != ACTION_STATUS_RUNNING)
-        {
-            // nothing to do
-            return;
-        }
+        return to_storage<Rest...>(action);
+    } else
+    {
+        return action_storage_t{std::move(action)};
+    }
+}
 
-        auto& idx = current_action;
+void wf::touch::gesture_t::impl_deleter_t::operator ()(impl *priv) const
+{
+    priv->~impl();
+    resource->deallocate(priv, sizeof(impl), alignof(impl));
+}
 
-        auto old_finger_state = finger_state;
-        finger_state.update(event);
+/** Allocate the state of a gesture from the given memory resource. */
+template<class Impl, class Deleter>
+static std::unique_ptr<Impl, Deleter> create_impl(std::pmr::memory_resource *resource)
+{
+    void *memory = resource->allocate(sizeof(Impl), alignof(Impl));
+    return std::unique_ptr<Impl, Deleter>(new (memory) Impl(resource), Deleter{resource});
+}
 
-        auto next_action = [&] () -> bool
-        {
-            timer->reset();
-            ++idx;
-            if (idx < actions.size())
-            {
-                actions[idx]->reset(event.time);
-                finger_state.reset_origin();
-                start_timer();
-                return true;
-            }
-
-            return false;
-        };
-
-        action_status_t pending_status = actions[idx]->update_state(finger_state, event);
-        switch (pending_status)
-        {
-          case ACTION_STATUS_RUNNING:
-            return; // nothing more to do
-
-          case ACTION_STATUS_CANCELLED:
-            this->status = ACTION_STATUS_CANCELLED;
-            timer->reset();
-            cancelled();
-            return;
-
-          case ACTION_STATUS_COMPLETED:
-            bool has_next = next_action();
-            if (!has_next)
-            {
-                this->status = ACTION_STATUS_COMPLETED;
-                completed();
-                return;
-            }
-        }
+wf::touch::gesture_t::gesture_t(std::vector<std::unique_ptr<gesture_action_t>> actions,
+        gesture_callback_t completed, gesture_callback_t cancelled)
+{
+    this->priv = create_impl<impl, impl_deleter_t>(std::pmr::get_default_resource());
+    priv->actions.reserve(actions.size());
+    for (auto& action : actions)
+    {
+        priv->actions.push_back(to_storage<touch_action_t, hold_action_t,
+            drag_action_t, pinch_action_t, rotate_action_t>(action));
     }
-};
 
-void wf::touch::gesture_t::set_timer(std::unique_ptr<timer_interface_t> timer)
+    priv->completed = std::move(completed);
+    priv->cancelled = std::move(cancelled);
+    priv->enable_history();
+}
+
+wf::touch::gesture_t::gesture_t(std::vector<action_storage_t> actions,
+        gesture_callback_t completed, gesture_callback_t cancelled)
 {
-    priv->timer = std::move(timer);
+    this->priv = create_impl<impl, impl_deleter_t>(std::pmr::get_default_resource());
+    priv->actions.assign(std::make_move_iterator(actions.begin()),
+        std::make_move_iterator(actions.end()));
+    priv->completed = std::move(completed);
+    priv->cancelled = std::move(cancelled);
+    priv->enable_history();
 }
 
-wf::touch::gesture_t::gesture_t(std::vector<std::unique_ptr<gesture_action_t>> actions,
+wf::touch::gesture_t::gesture_t(std::pmr::vector<action_storage_t> actions,
         gesture_callback_t completed, gesture_callback_t cancelled)
 {
-    this->priv = std::make_unique<impl>();
+    this->priv = create_impl<impl, impl_deleter_t>(actions.get_allocator().resource());
     priv->actions = std::move(actions);
-    priv->completed = completed;
-    priv->cancelled = cancelled;
+    priv->completed = std::move(completed);
+    priv->cancelled = std::move(cancelled);
+    priv->enable_history();
 }
 
 wf::touch::gesture_t::gesture_t(gesture_t&& other)
@@ -196,12 +466,33 @@ double wf::touch::gesture_t::get_progress() const
 
 void wf::touch::gesture_t::update_state(const gesture_event_t& event)
 {
-    assert(priv->timer);
     assert(!priv->actions.empty());
 
     priv->update_state(event);
 }
 
+size_t wf::touch::gesture_t::update_state(const gesture_event_t *events, size_t count)
+{
+    assert(!priv->actions.empty());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (priv->status != ACTION_STATUS_RUNNING)
+        {
+            return i;
+        }
+
+        priv->update_state(events[i]);
+    }
+
+    return count;
+}
+
+void wf::touch::gesture_t::advance_time(uint32_t now)
+{
+    priv->expire_deadlines(now);
+}
+
 wf::touch::action_status_t wf::touch::gesture_t::get_status() const
 {
     return priv->status;
@@ -209,7 +500,6 @@ wf::touch::action_status_t wf::touch::gesture_t::get_status() const
 
 void wf::touch::gesture_t::reset(uint32_t time)
 {
-    assert(priv->timer);
     assert(!priv->actions.empty());
 
     if (priv->status == ACTION_STATUS_RUNNING)
@@ -220,21 +510,39 @@ void wf::touch::gesture_t::reset(uint32_t time)
     priv->start_gesture(time);
 }
 
-wf::touch::gesture_builder_t::gesture_builder_t() {}
+wf::touch::gesture_builder_t::gesture_builder_t()
+{
+    actions.reserve(RESERVED_ACTIONS);
+}
+
+wf::touch::gesture_builder_t::gesture_builder_t(std::pmr::memory_resource *resource) :
+    actions(resource)
+{
+    actions.reserve(RESERVED_ACTIONS);
+}
 
 wf::touch::gesture_builder_t& wf::touch::gesture_builder_t::on_completed(gesture_callback_t callback)
 {
-    this->_on_completed = callback;
+    this->_on_completed = std::move(callback);
     return *this;
 }
 
 wf::touch::gesture_builder_t& wf::touch::gesture_builder_t::on_cancelled(gesture_callback_t callback)
 {
-    this->_on_cancelled = callback;
+    this->_on_cancelled = std::move(callback);
+    return *this;
+}
+
+wf::touch::gesture_builder_t& wf::touch::gesture_builder_t::on_update(
+    gesture_update_callback_t callback)
+{
+    this->_on_update = std::move(callback);
     return *this;
 }
 
 wf::touch::gesture_t wf::touch::gesture_builder_t::build()
 {
-    return gesture_t(std::move(actions), _on_completed, _on_cancelled);
+    gesture_t gesture(std::move(actions), std::move(_on_completed), std::move(_on_cancelled));
+    gesture.set_update_callback(std::move(_on_update));
+    return gesture;
 }
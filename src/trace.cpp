@@ -0,0 +1,326 @@
+#include <wayfire/touch/trace.hpp>
+#include "time-util.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace wf::touch;
+
+static constexpr char TRACE_MAGIC[4] = {'W', 'F', 'T', 'T'};
+static constexpr uint8_t TRACE_VERSION = 1;
+static constexpr size_t TRACE_HEADER_SIZE = 12;
+
+static constexpr uint8_t TAG_TYPE_MASK = 0b011;
+static constexpr uint8_t TAG_SAME_FINGER = 0b100;
+
+/* Events are buffered and written out in chunks of this size. */
+static constexpr size_t WRITE_BUFFER_SIZE = 64 * 1024;
+/* Maximal size of a single encoded event: tag + 4 varints. */
+static constexpr size_t MAX_EVENT_SIZE = 1 + 4 * 10;
+
+/* -------------------------- Trace writer ---------------------------------- */
+wf::touch::trace_writer_t::trace_writer_t(const std::string& path, uint32_t subpixels)
+{
+    this->subpixels = subpixels;
+    this->file = std::fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        return;
+    }
+
+    uint8_t header[TRACE_HEADER_SIZE] = {};
+    std::memcpy(header, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header[4] = TRACE_VERSION;
+    for (int i = 0; i < 4; i++)
+    {
+        header[8 + i] = (subpixels >> (8 * i)) & 0xff;
+    }
+
+    std::fwrite(header, 1, sizeof(header), file);
+    buffer.reserve(WRITE_BUFFER_SIZE);
+}
+
+wf::touch::trace_writer_t::~trace_writer_t()
+{
+    if (file)
+    {
+        flush();
+        std::fclose(file);
+    }
+}
+
+bool wf::touch::trace_writer_t::is_open() const
+{
+    return file;
+}
+
+void wf::touch::trace_writer_t::put_varint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+
+    buffer.push_back(value);
+}
+
+void wf::touch::trace_writer_t::put_zigzag(int64_t value)
+{
+    put_varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void wf::touch::trace_writer_t::record(const gesture_event_t& event)
+{
+    if (!file || (event.type == EVENT_TYPE_TIMEOUT))
+    {
+        return;
+    }
+
+    if (buffer.size() + MAX_EVENT_SIZE > WRITE_BUFFER_SIZE)
+    {
+        flush();
+    }
+
+    const bool same_finger = has_last_finger && (event.finger == last_finger);
+    buffer.push_back((event.type & TAG_TYPE_MASK) | (same_finger ? TAG_SAME_FINGER : 0));
+    put_varint((uint32_t)(event.time - last_time));
+    if (!same_finger)
+    {
+        put_zigzag(event.finger);
+    }
+
+    put_zigzag(std::llround(event.pos.x * subpixels));
+    put_zigzag(std::llround(event.pos.y * subpixels));
+
+    last_time = event.time;
+    last_finger = event.finger;
+    has_last_finger = true;
+}
+
+void wf::touch::trace_writer_t::flush()
+{
+    if (file && !buffer.empty())
+    {
+        std::fwrite(buffer.data(), 1, buffer.size(), file);
+        std::fflush(file);
+    }
+
+    buffer.clear();
+}
+
+/* -------------------------- Trace reader ---------------------------------- */
+wf::touch::trace_reader_t::trace_reader_t(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && ((size_t)st.st_size >= TRACE_HEADER_SIZE))
+    {
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            this->data = (const uint8_t*)map;
+            this->size = st.st_size;
+        }
+    }
+
+    close(fd);
+    if (!data)
+    {
+        return;
+    }
+
+    uint32_t header_subpixels = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        header_subpixels |= (uint32_t)data[8 + i] << (8 * i);
+    }
+
+    if (std::memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC)) ||
+        (data[4] != TRACE_VERSION) || (header_subpixels == 0))
+    {
+        munmap((void*)data, size);
+        data = nullptr;
+        return;
+    }
+
+    madvise((void*)data, size, MADV_SEQUENTIAL);
+    this->subpixels = header_subpixels;
+    rewind();
+}
+
+wf::touch::trace_reader_t::~trace_reader_t()
+{
+    if (data)
+    {
+        munmap((void*)data, size);
+    }
+}
+
+bool wf::touch::trace_reader_t::is_open() const
+{
+    return data;
+}
+
+void wf::touch::trace_reader_t::rewind()
+{
+    offset = TRACE_HEADER_SIZE;
+    last_time = 0;
+    last_finger = 0;
+}
+
+bool wf::touch::trace_reader_t::get_varint(uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (offset >= size)
+        {
+            return false;
+        }
+
+        uint8_t byte = data[offset++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool wf::touch::trace_reader_t::get_zigzag(int64_t& value)
+{
+    uint64_t raw;
+    if (!get_varint(raw))
+    {
+        return false;
+    }
+
+    value = (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+    return true;
+}
+
+bool wf::touch::trace_reader_t::next(gesture_event_t& event)
+{
+    if (!data || (offset >= size))
+    {
+        return false;
+    }
+
+    const uint8_t tag = data[offset++];
+    uint64_t time_delta;
+    int64_t finger = last_finger, x, y;
+    if (!get_varint(time_delta) ||
+        (!(tag & TAG_SAME_FINGER) && !get_zigzag(finger)) ||
+        !get_zigzag(x) || !get_zigzag(y))
+    {
+        // truncated trace
+        offset = size;
+        return false;
+    }
+
+    last_time += time_delta;
+    last_finger = finger;
+
+    event.type = (gesture_event_type_t)(tag & TAG_TYPE_MASK);
+    event.time = last_time;
+    event.finger = last_finger;
+    event.pos = point_t{x / subpixels, y / subpixels};
+    return true;
+}
+
+/* -------------------------- Replay clock ---------------------------------- */
+class wf::touch::replay_clock_t::timer_t : public timer_interface_t
+{
+  public:
+    replay_clock_t *clock;
+    std::function<void()> handler;
+    uint32_t deadline = 0;
+    bool armed = false;
+
+    timer_t(replay_clock_t *clock)
+    {
+        this->clock = clock;
+        clock->timers.push_back(this);
+    }
+
+    ~timer_t()
+    {
+        auto& timers = clock->timers;
+        timers.erase(std::remove(timers.begin(), timers.end(), this), timers.end());
+    }
+
+    void set_timeout(uint32_t msec, std::function<void()> handler) override
+    {
+        this->handler = std::move(handler);
+        this->deadline = clock->current_time + msec;
+        this->armed = true;
+    }
+
+    void reset() override
+    {
+        this->armed = false;
+    }
+};
+
+std::unique_ptr<timer_interface_t> wf::touch::replay_clock_t::create_timer()
+{
+    return std::make_unique<timer_t>(this);
+}
+
+void wf::touch::replay_clock_t::advance(uint32_t time)
+{
+    if (!started)
+    {
+        for (auto& timer : timers)
+        {
+            timer->deadline += time - current_time;
+        }
+
+        current_time = time;
+        started = true;
+    }
+
+    while (true)
+    {
+        timer_t *next = nullptr;
+        for (auto& timer : timers)
+        {
+            if (timer->armed && !time_before(time, timer->deadline) &&
+                (!next || time_before(timer->deadline, next->deadline)))
+            {
+                next = timer;
+            }
+        }
+
+        if (!next)
+        {
+            break;
+        }
+
+        // The handler may arm the timer again.
+        current_time = next->deadline;
+        next->armed = false;
+        auto handler = std::move(next->handler);
+        handler();
+    }
+
+    current_time = time;
+}
+
+uint32_t wf::touch::replay_clock_t::now() const
+{
+    return current_time;
+}
@@ -109,12 +109,15 @@ TEST_CASE("wf::touch::drag_action_t")
 
     // check ok
     drag.reset(0);
+    CHECK(drag.get_progress() == 0.0);
     CHECK(drag.update_state(state, ev) == ACTION_STATUS_COMPLETED);
+    CHECK(drag.get_progress() == doctest::Approx(1.0));
 
     // check distance not enough
     drag.reset(0);
     state.fingers[0] = finger_in_dir(-49, 0);
     CHECK(drag.update_state(state, ev) == ACTION_STATUS_RUNNING);
+    CHECK(drag.get_progress() == doctest::Approx(0.99));
 
     // check exceeds tolerance
     state.fingers[1] = finger_in_dir(0, 6);
@@ -128,6 +131,52 @@ TEST_CASE("wf::touch::drag_action_t")
     CHECK(drag.update_state(state, ev) == ACTION_STATUS_CANCELLED);
 }
 
+TEST_CASE("wf::touch::flick_action_t")
+{
+    flick_action_t flick{MOVE_DIRECTION_RIGHT, 1};
+    flick.set_move_tolerance(5);
+    CHECK(flick.get_history_size() == flick_action_t::HISTORY_SIZE);
+
+    gesture_state_t state;
+    state.history.set_capacity(flick.get_history_size());
+    state.update({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 0, .pos = {0, 0}});
+    flick.reset(0);
+
+    auto move = [&] (uint32_t time, point_t pos)
+    {
+        gesture_event_t ev{.type = EVENT_TYPE_MOTION, .time = time, .finger = 0, .pos = pos};
+        state.update(ev);
+        return flick.update_state(state, ev);
+    };
+
+    SUBCASE("fast")
+    {
+        // short, but fast enough
+        CHECK(move(10, {5, 0}) == ACTION_STATUS_RUNNING);
+        CHECK(move(20, {25, 0}) == ACTION_STATUS_COMPLETED);
+    }
+
+    SUBCASE("slow")
+    {
+        for (uint32_t t = 10; t <= 500; t += 10)
+        {
+            CHECK(move(t, {t / 2.0, 0}) == ACTION_STATUS_RUNNING);
+        }
+    }
+
+    SUBCASE("wrong direction")
+    {
+        CHECK(move(10, {0, 20}) == ACTION_STATUS_CANCELLED);
+    }
+
+    SUBCASE("touch up")
+    {
+        gesture_event_t ev{.type = EVENT_TYPE_TOUCH_UP, .time = 10, .finger = 0, .pos = {50, 0}};
+        state.update(ev);
+        CHECK(flick.update_state(state, ev) == ACTION_STATUS_CANCELLED);
+    }
+}
+
 TEST_CASE("wf::touch::pinch_action_t")
 {
     pinch_action_t in{0.5}, out{2};
@@ -143,11 +192,14 @@ TEST_CASE("wf::touch::pinch_action_t")
     // ok
     out.reset(0);
     CHECK(out.update_state(state, ev) == ACTION_STATUS_COMPLETED);
+    CHECK(out.get_progress() == doctest::Approx(state.get_pinch_scale() - 1.0));
+    CHECK(out.get_progress() >= 1.0);
 
     std::swap(state.fingers[0].origin, state.fingers[0].current);
     std::swap(state.fingers[1].origin, state.fingers[1].current);
     in.reset(0);
     CHECK(in.update_state(state, ev) == ACTION_STATUS_COMPLETED);
+    CHECK(in.get_progress() == doctest::Approx((1.0 - state.get_pinch_scale()) / 0.5));
 
     // too much movement
     in.set_move_tolerance(1);
@@ -177,6 +229,217 @@ TEST_CASE("wf::touch::rotate_action_t")
     gesture_event_t ev;
     ev.type = EVENT_TYPE_MOTION;
     CHECK(rotate.update_state(state, ev) == ACTION_STATUS_COMPLETED);
+    CHECK(rotate.get_progress() == doctest::Approx(1.5));
 
     // TODO: incomplete tests
 }
+
+TEST_CASE("wf::touch::any_of_action_t")
+{
+    any_of_action_t pinch_or_rotate = any_of_action_t()
+        .action(pinch_action_t(2).set_move_tolerance(1))
+        .action(rotate_action_t(-M_PI / 3.0));
+    CHECK(pinch_or_rotate.size() == 2);
+
+    gesture_event_t ev;
+    ev.type = EVENT_TYPE_MOTION;
+    ev.time = 0;
+
+    // rotation without moving the center
+    gesture_state_t state;
+    state.fingers[0] = finger_2p(0, 1, 1, 0);
+    state.fingers[1] = finger_2p(0, -1, -1, 0);
+    pinch_or_rotate.reset(0);
+    CHECK(pinch_or_rotate.update_state(state, ev) == ACTION_STATUS_COMPLETED);
+
+    // the pinch moves too much, the rotation is not far enough yet
+    state.fingers[0] = finger_2p(0, 1, 2, 1);
+    state.fingers[1] = finger_2p(0, -1, 2, -1);
+    pinch_or_rotate.reset(0);
+    CHECK(pinch_or_rotate.update_state(state, ev) == ACTION_STATUS_RUNNING);
+
+    // both cancel
+    ev.type = EVENT_TYPE_TOUCH_DOWN;
+    CHECK(pinch_or_rotate.update_state(state, ev) == ACTION_STATUS_CANCELLED);
+}
+
+TEST_CASE("wf::touch::all_of_action_t")
+{
+    all_of_action_t hold_and_drag = all_of_action_t()
+        .action(hold_action_t(100))
+        .action(drag_action_t(MOVE_DIRECTION_LEFT, 10));
+
+    gesture_state_t state;
+    state.fingers[0] = finger_in_dir(-5, 0);
+    gesture_event_t ev;
+    ev.type = EVENT_TYPE_MOTION;
+    ev.time = 50;
+    hold_and_drag.reset(0);
+    CHECK(hold_and_drag.update_state(state, ev) == ACTION_STATUS_RUNNING);
+
+    SUBCASE("drag first")
+    {
+        state.fingers[0] = finger_in_dir(-10, 0);
+        ev.time = 60;
+        CHECK(hold_and_drag.update_state(state, ev) == ACTION_STATUS_RUNNING);
+        // the hold completes with the next event after its duration
+        ev.time = 100;
+        CHECK(hold_and_drag.update_state(state, ev) == ACTION_STATUS_COMPLETED);
+    }
+
+    SUBCASE("hold first")
+    {
+        ev.time = 120;
+        CHECK(hold_and_drag.update_state(state, ev) == ACTION_STATUS_RUNNING);
+        state.fingers[0] = finger_in_dir(-10, 0);
+        CHECK(hold_and_drag.update_state(state, ev) == ACTION_STATUS_COMPLETED);
+    }
+
+    SUBCASE("one cancels")
+    {
+        ev.type = EVENT_TYPE_TOUCH_UP;
+        CHECK(hold_and_drag.update_state(state, ev) == ACTION_STATUS_CANCELLED);
+    }
+}
+
+TEST_CASE("wf::touch::repeat_action_t")
+{
+    repeat_action_t double_tap = repeat_action_t(2)
+        .action(touch_action_t(1, true))
+        .action(touch_action_t(1, false).set_duration(100));
+
+    gesture_state_t state;
+    gesture_event_t down{.type = EVENT_TYPE_TOUCH_DOWN, .time = 0};
+    gesture_event_t up{.type = EVENT_TYPE_TOUCH_UP, .time = 50};
+
+    double_tap.reset(0);
+    state.fingers[0] = finger_2p(0, 0, 0, 0);
+    CHECK(double_tap.update_state(state, down) == ACTION_STATUS_RUNNING);
+    state.fingers.erase(0);
+    CHECK(double_tap.update_state(state, up) == ACTION_STATUS_RUNNING);
+
+    down.time = up.time = 200;
+    state.fingers[1] = finger_2p(0, 0, 0, 0);
+    CHECK(double_tap.update_state(state, down) == ACTION_STATUS_RUNNING);
+
+    SUBCASE("second tap")
+    {
+        state.fingers.erase(1);
+        CHECK(double_tap.update_state(state, up) == ACTION_STATUS_COMPLETED);
+    }
+
+    SUBCASE("second tap too long")
+    {
+        up.time = 300;
+        state.fingers.erase(1);
+        CHECK(double_tap.update_state(state, up) == ACTION_STATUS_CANCELLED);
+    }
+}
+
+TEST_CASE("wf::touch::gesture_action_t::will_never_complete")
+{
+    gesture_state_t state;
+    gesture_event_t motion{.type = EVENT_TYPE_MOTION};
+
+    SUBCASE("touch")
+    {
+        touch_action_t touch_down{2, true};
+        touch_down.set_target({0, 0, 10, 10});
+        touch_down.set_move_tolerance(5);
+        touch_down.reset(0);
+
+        // only the next touch down checks a finger which was already down
+        state.fingers[0] = finger_2p(20, 20, 20, 20);
+        CHECK(touch_down.update_state(state, motion) == ACTION_STATUS_RUNNING);
+        CHECK(touch_down.will_never_complete(state));
+
+        state.fingers[0] = finger_2p(5, 5, 5, 5);
+        CHECK(!touch_down.will_never_complete(state));
+        state.fingers[0] = finger_2p(5, 5, 5, 11);
+        CHECK(touch_down.will_never_complete(state));
+
+        // the position at which a finger is lifted is checked when it is lifted
+        touch_action_t touch_up{1, false};
+        touch_up.set_target({0, 0, 10, 10});
+        touch_up.reset(0);
+        state.fingers[0] = finger_2p(20, 20, 20, 20);
+        CHECK(!touch_up.will_never_complete(state));
+    }
+
+    SUBCASE("hold")
+    {
+        hold_action_t hold{50};
+        hold.set_move_tolerance(1);
+        hold.reset(0);
+        state.fingers[0] = finger_in_dir(1, 0);
+        CHECK(!hold.will_never_complete(state));
+        state.fingers[0] = finger_in_dir(2, 0);
+        CHECK(hold.will_never_complete(state));
+    }
+
+    SUBCASE("drag")
+    {
+        drag_action_t drag{MOVE_DIRECTION_LEFT, 50};
+        drag.set_move_tolerance(5);
+        drag.reset(0);
+        state.fingers[0] = finger_in_dir(-10, 5);
+        CHECK(drag.update_state(state, motion) == ACTION_STATUS_RUNNING);
+        CHECK(!drag.will_never_complete(state));
+        state.fingers[0] = finger_in_dir(-10, 6);
+        CHECK(drag.will_never_complete(state));
+
+        flick_action_t flick{MOVE_DIRECTION_LEFT, 1000};
+        flick.set_move_tolerance(5);
+        flick.reset(0);
+        CHECK(flick.will_never_complete(state));
+        state.fingers[0] = finger_in_dir(-10, -5);
+        CHECK(!flick.will_never_complete(state));
+    }
+
+    SUBCASE("pinch and rotate")
+    {
+        pinch_action_t pinch{2};
+        pinch.set_move_tolerance(1);
+        rotate_action_t rotate{M_PI};
+        rotate.set_move_tolerance(1);
+        state.fingers[0] = finger_2p(1, 0, 2, 0);
+        state.fingers[1] = finger_2p(-1, 0, -2, 0);
+        CHECK(!pinch.will_never_complete(state));
+        CHECK(!rotate.will_never_complete(state));
+
+        state.fingers[0].current += point_t{2, 2};
+        state.fingers[1].current += point_t{2, 2};
+        CHECK(pinch.will_never_complete(state));
+        CHECK(rotate.will_never_complete(state));
+    }
+
+    SUBCASE("groups")
+    {
+        auto hold_and_drag = all_of_action_t()
+            .action(hold_action_t(100).set_move_tolerance(20))
+            .action(drag_action_t(MOVE_DIRECTION_LEFT, 50).set_move_tolerance(5));
+        auto hold_or_drag = any_of_action_t()
+            .action(hold_action_t(100).set_move_tolerance(20))
+            .action(drag_action_t(MOVE_DIRECTION_LEFT, 50).set_move_tolerance(5));
+        auto twice = repeat_action_t(2)
+            .action(drag_action_t(MOVE_DIRECTION_LEFT, 50).set_move_tolerance(5));
+        hold_and_drag.reset(0);
+        hold_or_drag.reset(0);
+        twice.reset(0);
+
+        state.fingers[0] = finger_in_dir(-10, 0);
+        CHECK(!hold_and_drag.will_never_complete(state));
+        CHECK(!hold_or_drag.will_never_complete(state));
+        CHECK(!twice.will_never_complete(state));
+
+        // only the drag is out of its tolerance
+        state.fingers[0] = finger_in_dir(-10, 10);
+        CHECK(hold_and_drag.will_never_complete(state));
+        CHECK(!hold_or_drag.will_never_complete(state));
+        CHECK(twice.will_never_complete(state));
+
+        // both are
+        state.fingers[0] = finger_in_dir(-10, 30);
+        CHECK(hold_or_drag.will_never_complete(state));
+    }
+}
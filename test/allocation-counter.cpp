@@ -0,0 +1,56 @@
+#include "allocation-counter.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+static size_t cnt_allocations = 0;
+
+void *operator new(size_t size)
+{
+    ++cnt_allocations;
+    if (void *ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+// The default memory resource allocates with the alignment of the type
+void *operator new(size_t size, std::align_val_t align)
+{
+    ++cnt_allocations;
+    const size_t alignment = std::max(sizeof(void*), (size_t)align);
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, size ? size : 1) == 0)
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+size_t get_allocation_count()
+{
+    return cnt_allocations;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+/**
+ * Counting of heap allocations, shared by the tests and the benchmarks.
+ *
+ * allocation-counter.cpp replaces the global operator new, so a program
+ * which links it can check how many heap allocations some code makes.
+ */
+#include <cstddef>
+
+/** @return The number of heap allocations made so far. */
+size_t get_allocation_count();
@@ -0,0 +1,277 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <wayfire/touch/touch.hpp>
+#include <wayfire/touch/timer-wheel.hpp>
+#include <wayfire/touch/gesture-set.hpp>
+#include "allocation-counter.hpp"
+#include <algorithm>
+
+using namespace wf::touch;
+
+/** A timer which does not allocate when armed with a small callback. */
+class static_timer_t : public timer_interface_t
+{
+  public:
+    std::function<void()> last_cb;
+
+    void set_timeout(uint32_t, std::function<void()> cb) override
+    {
+        last_cb = std::move(cb);
+    }
+
+    void reset() override
+    {}
+};
+
+TEST_CASE("gesture_t::update_state does not allocate")
+{
+    int completed = 0;
+    gesture_t swipe = gesture_builder_t()
+        .action(touch_action_t(2, true))
+        .action(drag_action_t(MOVE_DIRECTION_LEFT, 100).set_move_tolerance(20))
+        .action(hold_action_t(50))
+        .on_completed([&] () { ++completed; })
+        .build();
+    swipe.set_timer(std::make_unique<static_timer_t>());
+
+    auto motion = [] (int finger, double x, uint32_t time)
+    {
+        return gesture_event_t{.type = EVENT_TYPE_MOTION, .time = time,
+            .finger = finger, .pos = {x, 0}};
+    };
+
+    swipe.reset(0);
+    swipe.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 0, .pos = {0, 0}});
+    swipe.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 1, .pos = {0, 0}});
+
+    size_t before = get_allocation_count();
+    CHECK(before > 0);
+    for (int i = 1; i <= 100; i++)
+    {
+        swipe.update_state(motion(0, -i, i));
+        swipe.update_state(motion(1, -i, i));
+    }
+
+    CHECK(get_allocation_count() == before);
+    CHECK(swipe.get_status() == ACTION_STATUS_RUNNING);
+    CHECK(swipe.get_progress() > 0.5);
+
+    // The hold action is running now, motion does not allocate there either
+    swipe.update_state(motion(0, -101, 101));
+    CHECK(get_allocation_count() == before);
+    CHECK(completed == 0);
+}
+
+TEST_CASE("the finger history allocates only at the first touch")
+{
+    int completed = 0;
+    gesture_t flick = gesture_builder_t()
+        .action(touch_action_t(1, true))
+        .action(flick_action_t(MOVE_DIRECTION_LEFT, 1))
+        .on_completed([&] () { ++completed; })
+        .build();
+
+    auto play = [&] (uint32_t start)
+    {
+        flick.reset(start);
+        flick.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = start, .finger = 0,
+            .pos = {0, 0}});
+        for (int i = 1; i <= 50; i++)
+        {
+            flick.update_state({.type = EVENT_TYPE_MOTION, .time = start + i, .finger = 0,
+                .pos = {-0.5 * i * i, 0}});
+        }
+
+        flick.update_state({.type = EVENT_TYPE_TOUCH_UP, .time = start + 51, .finger = 0,
+            .pos = {0, 0}});
+    };
+
+    play(0);
+    size_t before = get_allocation_count();
+    play(100);
+    play(200);
+    CHECK(get_allocation_count() == before);
+    CHECK(completed == 3);
+}
+
+/** A custom action which counts how often it is copied and moved. */
+class counted_action_t : public gesture_action_t
+{
+  public:
+    static inline int copies = 0;
+    static inline int moves = 0;
+
+    counted_action_t() = default;
+    counted_action_t(const counted_action_t& other) : gesture_action_t(other)
+    {
+        ++copies;
+    }
+
+    counted_action_t(counted_action_t&& other) : gesture_action_t(std::move(other))
+    {
+        ++moves;
+    }
+
+    action_status_t update_state(const gesture_state_t&, const gesture_event_t&) override
+    {
+        return ACTION_STATUS_RUNNING;
+    }
+};
+
+TEST_CASE("gesture_builder_t moves actions and callbacks")
+{
+    // large enough not to fit in std::function's small buffer
+    std::array<int, 32> payload{};
+    gesture_callback_t on_completed = [payload] () { (void)payload; };
+    gesture_callback_t on_cancelled = [payload] () { (void)payload; };
+
+    size_t before = get_allocation_count();
+    gesture_t gesture = gesture_builder_t()
+        .action(touch_action_t(2, true))
+        .emplace<drag_action_t>(MOVE_DIRECTION_LEFT, 100)
+        .action(hold_action_t(50))
+        .on_completed(std::move(on_completed))
+        .on_cancelled(std::move(on_cancelled))
+        .build();
+
+    // the action array and the gesture itself
+    CHECK(get_allocation_count() - before == 2);
+
+    // custom actions are allocated on their own, without being copied
+    counted_action_t::copies = counted_action_t::moves = 0;
+    before = get_allocation_count();
+    gesture = gesture_builder_t()
+        .action(touch_action_t(1, true))
+        .action(counted_action_t())
+        .emplace<counted_action_t>()
+        .build();
+    CHECK(get_allocation_count() - before == 4);
+    CHECK(counted_action_t::copies == 0);
+    CHECK(counted_action_t::moves == 1);
+
+    counted_action_t named;
+    gesture = gesture_builder_t().action(named).build();
+    CHECK(counted_action_t::copies == 1);
+}
+
+TEST_CASE("gesture_builder_t allocates the actions once")
+{
+    for (size_t cnt_actions = 1; cnt_actions <= 2 * gesture_builder_t::RESERVED_ACTIONS;
+         cnt_actions++)
+    {
+        size_t before = get_allocation_count();
+        gesture_builder_t builder;
+        for (size_t i = 0; i < cnt_actions; i++)
+        {
+            builder.action(hold_action_t(10));
+        }
+
+        gesture_t gesture = builder.build();
+        // the action array grows once it is full
+        const size_t expected = (cnt_actions <= gesture_builder_t::RESERVED_ACTIONS) ? 2 : 3;
+        CHECK(get_allocation_count() - before == expected);
+    }
+}
+
+TEST_CASE("gesture_set_t builds gestures from its arena")
+{
+    static constexpr int CNT_GESTURES = 100;
+    gesture_set_t set;
+    auto build = [&] ()
+    {
+        for (int i = 0; i < CNT_GESTURES; i++)
+        {
+            set.add(gesture_builder_t(set.get_arena())
+                .action(touch_action_t(1 + i % 5, true))
+                .action(drag_action_t(MOVE_DIRECTION_LEFT, 10 + i))
+                .action(hold_action_t(50))
+                .build());
+        }
+    };
+
+    size_t before = get_allocation_count();
+    build();
+    // the arena allocates in large blocks
+    CHECK(get_allocation_count() - before < CNT_GESTURES / 4);
+    CHECK(set.size() == CNT_GESTURES);
+
+    set.clear();
+    before = get_allocation_count();
+    build();
+    CHECK(get_allocation_count() - before < CNT_GESTURES / 4);
+}
+
+TEST_CASE("gesture_set_t does not allocate when gestures stop sharing fingers")
+{
+    // the drag keeps no history, the flick keeps the history of the set
+    size_t drag_capacity = 0;
+    gesture_set_t set;
+    set.add(gesture_builder_t()
+        .action(touch_action_t(1, true))
+        .action(drag_action_t(MOVE_DIRECTION_LEFT, 1000))
+        .on_update([&] (const gesture_update_t& update)
+        {
+            if (update.action > 0)
+            {
+                drag_capacity = std::max(drag_capacity, update.state.history.get_capacity());
+            }
+        })
+        .build());
+    set.add(gesture_builder_t()
+        .action(touch_action_t(1, true))
+        .action(flick_action_t(MOVE_DIRECTION_LEFT, 1000))
+        .build());
+
+    auto play = [&] (uint32_t start)
+    {
+        set.reset(start);
+        set.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = start, .finger = 0,
+            .pos = {0, 0}});
+        for (int i = 1; i <= 20; i++)
+        {
+            set.update_state({.type = EVENT_TYPE_MOTION, .time = start + i, .finger = 0,
+                .pos = {-1.0 * i, 0}});
+        }
+
+        set.update_state({.type = EVENT_TYPE_TOUCH_UP, .time = start + 21, .finger = 0,
+            .pos = {-20, 0}});
+    };
+
+    play(0);
+    size_t before = get_allocation_count();
+    play(100);
+    play(200);
+    CHECK(get_allocation_count() == before);
+
+    // the drag does not take the history of the set when it stops sharing
+    CHECK(set.get_state().history.get_capacity() == flick_action_t::HISTORY_SIZE);
+    CHECK(drag_capacity == 0);
+}
+
+TEST_CASE("timer_wheel_t does not allocate when arming timers")
+{
+    uint32_t now = 0;
+    timer_wheel_t wheel{std::make_unique<static_timer_t>(), [&] () { return now; }};
+    std::vector<std::unique_ptr<timer_interface_t>> timers;
+    for (int i = 0; i < 16; i++)
+    {
+        timers.push_back(wheel.create_timer());
+    }
+
+    int fired = 0;
+    size_t before = get_allocation_count();
+    for (int round = 0; round < 100; round++)
+    {
+        for (size_t i = 0; i < timers.size(); i++)
+        {
+            timers[i]->set_timeout(i * 60, [&fired] () { ++fired; });
+        }
+
+        timers[round % timers.size()]->reset();
+        now += 1000;
+        wheel.advance(now);
+    }
+
+    CHECK(get_allocation_count() == before);
+    CHECK(fired == 100 * 15);
+}
@@ -1,6 +1,7 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 #include "shared.hpp"
+#include <random>
 
 TEST_CASE("get_move_in_direction")
 {
@@ -67,6 +68,149 @@ TEST_CASE("get_rotation_angle")
         doctest::Approx(2.0 * M_PI / 3.0).epsilon(0.05));
 }
 
+TEST_CASE("get_rotation_angle tracks multiple turns")
+{
+    // Three fingers turning a knob around (100, 100) three times, one finger
+    // moving at a time
+    gesture_state_t state;
+    auto on_circle = [] (int finger, double angle)
+    {
+        angle += finger * 2.0 * M_PI / 3.0;
+        return point_t{100 + 50 * std::cos(angle), 100 + 50 * std::sin(angle)};
+    };
+
+    for (int i = 0; i < 3; i++)
+    {
+        state.update({.type = EVENT_TYPE_TOUCH_DOWN, .finger = i, .pos = on_circle(i, 0)});
+    }
+
+    const int steps = 3 * 72;
+    for (int step = 1; step <= steps; step++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            state.update({.type = EVENT_TYPE_MOTION, .finger = i,
+                .pos = on_circle(i, step * 2.0 * M_PI / 72)});
+        }
+
+        if (step == 36)
+        {
+            CHECK(state.get_rotation_angle() == doctest::Approx(M_PI));
+        }
+    }
+
+    CHECK(state.get_rotation_angle() == doctest::Approx(6 * M_PI));
+
+    rotate_action_t rotate{5 * M_PI};
+    CHECK(rotate.update_state(state, {.type = EVENT_TYPE_MOTION}) == ACTION_STATUS_COMPLETED);
+
+    // Turning back, counted from the new origins
+    state.reset_origin();
+    CHECK(state.get_rotation_angle() == 0);
+    for (int step = 1; step <= 90; step++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            state.update({.type = EVENT_TYPE_MOTION, .finger = i,
+                .pos = on_circle(i, -step * 2.0 * M_PI / 72)});
+        }
+    }
+
+    CHECK(state.get_rotation_angle() == doctest::Approx(-2.5 * M_PI));
+
+    // Moving the fingers together does not rotate them
+    for (int i = 0; i < 3; i++)
+    {
+        state.update({.type = EVENT_TYPE_MOTION, .finger = i,
+            .pos = on_circle(i, -90 * 2.0 * M_PI / 72) + point_t{30, -20}});
+    }
+
+    CHECK(state.get_rotation_angle() == doctest::Approx(-2.5 * M_PI).epsilon(0.01));
+    for (int i = 0; i < 3; i++)
+    {
+        state.update({.type = EVENT_TYPE_TOUCH_UP, .finger = i});
+    }
+
+    CHECK(state.get_rotation_angle() == 0);
+}
+
+TEST_CASE("get_rotation_angle without tracking")
+{
+    // Fingers at different distances from the center, turning unevenly
+    gesture_state_t tracked;
+    const point_t origins[] = {{0, 0}, {80, 10}, {30, 60}, {-20, 40}};
+    for (int i = 0; i < 4; i++)
+    {
+        tracked.update({.type = EVENT_TYPE_TOUCH_DOWN, .finger = i, .pos = origins[i]});
+    }
+
+    for (int step = 1; step <= 10; step++)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            const double angle = step * (0.1 + 0.05 * i);
+            const point_t p = origins[i];
+            tracked.update({.type = EVENT_TYPE_MOTION, .finger = i,
+                .pos = {p.x * std::cos(angle) - p.y * std::sin(angle) + 3 * step,
+                    p.x * std::sin(angle) + p.y * std::cos(angle)}});
+        }
+    }
+
+    // The same fingers, modified directly, are not tracked
+    gesture_state_t direct;
+    for (auto& f : tracked.fingers)
+    {
+        direct.fingers[f.first] = f.second;
+    }
+
+    CHECK(tracked.get_rotation_angle() != 0);
+    CHECK(direct.get_rotation_angle() == doctest::Approx(tracked.get_rotation_angle()));
+}
+
+TEST_CASE("get_max_delta")
+{
+    gesture_state_t state;
+    state.fingers[0] = finger_in_dir(3, 4);
+    state.fingers[1] = finger_in_dir(1, 1);
+    CHECK(state.get_max_delta() == doctest::Approx(5));
+
+    state.fingers[1] = finger_in_dir(0, 6);
+    CHECK(state.get_max_delta() == doctest::Approx(6));
+}
+
+TEST_CASE("derived values follow finger updates")
+{
+    gesture_state_t state;
+    gesture_event_t ev;
+    ev.type = EVENT_TYPE_TOUCH_DOWN;
+    ev.finger = 0;
+    ev.pos = {-1, 0};
+    state.update(ev);
+    ev.finger = 1;
+    ev.pos = {1, 0};
+    state.update(ev);
+
+    CHECK(state.get_pinch_scale() == doctest::Approx(1));
+    CHECK(state.get_rotation_angle() == doctest::Approx(0));
+    CHECK(state.get_max_delta() == doctest::Approx(0));
+
+    // querying again without changes gives the same values
+    CHECK(state.get_pinch_scale() == doctest::Approx(1));
+
+    ev.type = EVENT_TYPE_MOTION;
+    ev.pos = {3, 0};
+    state.update(ev);
+    ev.finger = 0;
+    ev.pos = {-3, 0};
+    state.update(ev);
+    CHECK(state.get_pinch_scale() == doctest::Approx(3));
+    CHECK(state.get_max_delta() == doctest::Approx(2));
+
+    state.reset_origin();
+    CHECK(state.get_pinch_scale() == doctest::Approx(1));
+    CHECK(state.get_max_delta() == doctest::Approx(0));
+}
+
 TEST_CASE("finger_t")
 {
     CHECK(finger_in_dir(1, 1).delta() == point_t{1, 1});
@@ -127,6 +271,211 @@ TEST_CASE("gesture_state_t::update")
     compare_finger(state.fingers[1], finger_2p(7, -1, 7, -1));
 }
 
+TEST_CASE("finger_history_t")
+{
+    gesture_state_t state;
+    state.history.set_capacity(8);
+
+    auto event = [] (gesture_event_type_t type, int finger, uint32_t time, point_t pos)
+    {
+        return gesture_event_t{.type = type, .time = time, .finger = finger, .pos = pos};
+    };
+
+    // finger 0 at x = t^2 / 20, finger 1 at y = -t
+    state.update(event(EVENT_TYPE_TOUCH_DOWN, 0, 0, {0, 0}));
+    state.update(event(EVENT_TYPE_TOUCH_DOWN, 1, 0, {0, 0}));
+    CHECK(state.history.count_samples(0) == 1);
+    compare_point(state.history.get_velocity(0), {0, 0});
+    for (uint32_t t = 10; t <= 200; t += 10)
+    {
+        state.update(event(EVENT_TYPE_MOTION, 0, t, {t * t / 20.0, 0}));
+        state.update(event(EVENT_TYPE_MOTION, 1, t, {0, -1.0 * t}));
+    }
+
+    // the oldest samples were overwritten
+    CHECK(state.history.count_samples(0) == 8);
+    CHECK(state.history.count_samples(2) == 0);
+
+    compare_point(state.history.get_velocity(1), {0, -1});
+    compare_point(state.history.get_acceleration(1), {0, 0});
+    compare_point(state.history.get_acceleration(0), {0.1, 0});
+    compare_point(state.history.get_acceleration(0, 30), {0.1, 0});
+
+    // a line through the samples of a parabola lags behind
+    CHECK(state.history.get_velocity(0).x == doctest::Approx(16.5));
+    CHECK(state.history.get_velocity(0, 10).x == doctest::Approx(19.5));
+    compare_point(state.get_center_velocity(10), {19.5 / 2, -0.5});
+
+    // a lifted finger keeps its samples until it touches down again
+    state.update(event(EVENT_TYPE_TOUCH_UP, 1, 210, {0, -210}));
+    compare_point(state.history.get_velocity(1), {0, -1});
+    compare_point(state.get_center_velocity(10), {19.5, 0});
+    state.update(event(EVENT_TYPE_MOTION, 1, 220, {0, 0}));
+    compare_point(state.history.get_velocity(1), {0, -1});
+    state.update(event(EVENT_TYPE_TOUCH_DOWN, 1, 300, {0, 0}));
+    CHECK(state.history.count_samples(1) == 1);
+
+    // copies keep the samples
+    gesture_state_t copy = state;
+    CHECK(copy.history.get_capacity() == 8);
+    compare_point(copy.history.get_velocity(0, 10), {19.5, 0});
+
+    // an assigned history keeps its capacity and the latest samples
+    gesture_state_t smaller;
+    smaller.history.set_capacity(3);
+    smaller = state;
+    CHECK(smaller.history.get_capacity() == 3);
+    CHECK(smaller.history.count_samples(0) == 3);
+    CHECK(smaller.history.count_samples(1) == 1);
+    compare_point(smaller.history.get_velocity(0, 10), {19.5, 0});
+    compare_point(smaller.history.get_acceleration(0), {0.1, 0});
+
+    gesture_state_t disabled;
+    disabled = state;
+    CHECK(disabled.history.get_capacity() == 0);
+    CHECK(disabled.history.count_samples(0) == 0);
+
+    state.history.set_capacity(0);
+    state.update(event(EVENT_TYPE_MOTION, 0, 310, {0, 0}));
+    CHECK(state.history.count_samples(0) == 0);
+    compare_point(state.get_center_velocity(), {0, 0});
+}
+
+TEST_CASE("finger_map_t")
+{
+    finger_map_t fingers;
+    fingers[5] = finger_in_dir(5, 5);
+    fingers[1] = finger_in_dir(1, 1);
+    fingers[3] = finger_in_dir(3, 3);
+    CHECK(fingers.size() == 3);
+
+    // iteration is sorted by finger id, like std::map
+    std::vector<int> ids;
+    for (auto& f : fingers)
+    {
+        ids.push_back(f.first);
+        compare_finger(f.second, finger_in_dir(f.first, f.first));
+    }
+
+    CHECK(ids == std::vector<int>{1, 3, 5});
+
+    CHECK(fingers.count(3) == 1);
+    CHECK(fingers.erase(3) == 1);
+    CHECK(fingers.erase(3) == 0);
+    CHECK(fingers.count(3) == 0);
+    CHECK(fingers.find(3) == fingers.end());
+    CHECK(fingers.find(5)->first == 5);
+    CHECK(fingers.size() == 2);
+
+    fingers.clear();
+    CHECK(fingers.empty());
+}
+
+TEST_CASE("finger_map_t::version changes only on modification")
+{
+    finger_map_t fingers;
+    fingers[1] = finger_in_dir(1, 1);
+    uint64_t version = fingers.version();
+
+    // reading through non-const access
+    for (auto& f : fingers)
+    {
+        (void)f;
+    }
+
+    CHECK(fingers.find(1) != fingers.end());
+    CHECK(fingers.find(2) == fingers.end());
+    CHECK(fingers.erase(2) == 0);
+    CHECK(fingers.version() == version);
+
+    fingers.find(1)->second.current = {2, 2};
+    fingers.mark_modified();
+    CHECK(fingers.version() != version);
+    version = fingers.version();
+
+    fingers[1].current = {3, 3};
+    CHECK(fingers.version() != version);
+    version = fingers.version();
+
+    CHECK(fingers.erase(1) == 1);
+    CHECK(fingers.version() != version);
+}
+
+TEST_CASE("gesture_state_t::update with too many fingers")
+{
+    gesture_state_t state;
+    gesture_event_t ev;
+    ev.type = EVENT_TYPE_TOUCH_DOWN;
+    for (size_t i = 0; i <= finger_map_t::MAX_FINGERS; i++)
+    {
+        ev.finger = i;
+        ev.pos = {1.0 * i, 0};
+        state.update(ev);
+    }
+
+    CHECK(state.fingers.full());
+    CHECK(state.fingers.count(finger_map_t::MAX_FINGERS) == 0);
+
+    // Motion of the ignored finger is ignored as well
+    ev.type = EVENT_TYPE_MOTION;
+    state.update(ev);
+    CHECK(state.fingers.count(finger_map_t::MAX_FINGERS) == 0);
+
+    ev.type = EVENT_TYPE_TOUCH_UP;
+    ev.finger = 0;
+    state.update(ev);
+    CHECK(state.fingers.size() == finger_map_t::MAX_FINGERS - 1);
+}
+
+TEST_CASE("gesture_state_t::get_center is kept up to date")
+{
+    gesture_state_t state;
+    gesture_event_t ev;
+    ev.type = EVENT_TYPE_TOUCH_DOWN;
+    for (int i = 0; i < 3; i++)
+    {
+        ev.finger = i;
+        ev.pos = {10.0 * i, 0};
+        state.update(ev);
+    }
+
+    compare_finger(state.get_center(), finger_2p(10, 0, 10, 0));
+
+    // long drag with fractional steps, checked against a direct computation
+    ev.type = EVENT_TYPE_MOTION;
+    for (int step = 1; step <= 10000; step++)
+    {
+        ev.finger = step % 3;
+        ev.pos = {10.0 * ev.finger - 0.1 * step, 0.37 * step};
+        state.update(ev);
+    }
+
+    point_t sum_origin = {0, 0}, sum_current = {0, 0};
+    for (auto& f : state.fingers)
+    {
+        sum_origin += f.second.origin;
+        sum_current += f.second.current;
+    }
+
+    compare_finger(state.get_center(), finger_t{sum_origin / 3.0, sum_current / 3.0});
+
+    // origin reset makes the center delta exactly zero
+    state.reset_origin();
+    CHECK(state.get_center().delta() == point_t{0, 0});
+
+    // direct modification of the fingers is picked up
+    state.fingers[0].current += point_t{3, 3};
+    compare_point(state.get_center().delta(), {1, 1});
+
+    // lifting fingers
+    ev.type = EVENT_TYPE_TOUCH_UP;
+    ev.finger = 0;
+    state.update(ev);
+    ev.finger = 1;
+    state.update(ev);
+    compare_point(state.get_center().current, state.fingers.find(2)->second.current);
+}
+
 TEST_CASE("gesture_state_t::reset_origin")
 {
     gesture_state_t state;
@@ -136,6 +485,37 @@ TEST_CASE("gesture_state_t::reset_origin")
     compare_finger(state.fingers[0], finger_2p(6, 7, 6, 7));
 }
 
+TEST_CASE("motion_coalescer_t")
+{
+    motion_coalescer_t coalescer;
+    gesture_event_t ev;
+    ev.type = EVENT_TYPE_MOTION;
+
+    for (int i = 0; i < 5; i++)
+    {
+        ev.finger = 1;
+        ev.pos = {1.0 * i, 0};
+        CHECK(coalescer.push(ev));
+        ev.finger = 0;
+        ev.pos = {0, 1.0 * i};
+        CHECK(coalescer.push(ev));
+    }
+
+    CHECK(coalescer.size() == 2);
+
+    ev.type = EVENT_TYPE_TOUCH_UP;
+    CHECK(!coalescer.push(ev));
+
+    std::vector<gesture_event_t> flushed;
+    coalescer.flush([&] (const gesture_event_t& e) { flushed.push_back(e); });
+    REQUIRE(flushed.size() == 2);
+    CHECK(flushed[0].finger == 1);
+    CHECK(flushed[0].pos == point_t{4, 0});
+    CHECK(flushed[1].finger == 0);
+    CHECK(flushed[1].pos == point_t{0, 4});
+    CHECK(coalescer.size() == 0);
+}
+
 TEST_CASE("touch_target_t")
 {
     touch_target_t target{-1, 1, 2, 2};
@@ -144,3 +524,123 @@ TEST_CASE("touch_target_t")
     CHECK(!target.contains({1, 3}));
     CHECK(!target.contains({0, 5}));
 }
+
+TEST_CASE("finger math is the same with all instruction sets")
+{
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> coord(-500, 500);
+    const simd_level_t supported = get_supported_simd_level();
+
+    for (size_t cnt_fingers = 1; cnt_fingers <= finger_map_t::MAX_FINGERS; cnt_fingers++)
+    {
+        std::vector<finger_t> fingers;
+        for (size_t i = 0; i < cnt_fingers; i++)
+        {
+            fingers.push_back(finger_2p(coord(gen), coord(gen), coord(gen), coord(gen)));
+        }
+
+        double max_delta = 0;
+        double max_incorrect = 0;
+        for (auto& f : fingers)
+        {
+            max_delta = std::max(max_delta, std::sqrt(f.delta().x * f.delta().x + f.delta().y * f.delta().y));
+            max_incorrect = std::max(max_incorrect, f.get_incorrect_drag_distance(ld));
+        }
+
+        std::vector<double> scales, angles;
+        for (auto level : {SIMD_LEVEL_SCALAR, SIMD_LEVEL_SSE2, SIMD_LEVEL_AVX2})
+        {
+            set_simd_level(level);
+            CHECK(get_simd_level() == std::min(level, supported));
+
+            gesture_state_t state;
+            for (size_t i = 0; i < cnt_fingers; i++)
+            {
+                state.fingers[i] = fingers[i];
+            }
+
+            scales.push_back(state.get_pinch_scale());
+            angles.push_back(state.get_rotation_angle());
+            CHECK(state.get_max_delta() == doctest::Approx(max_delta));
+
+            gesture_event_t motion{.type = EVENT_TYPE_MOTION};
+            CHECK(drag_action_t(ld, 1e9).set_move_tolerance(std::floor(max_incorrect))
+                .update_state(state, motion) == ACTION_STATUS_CANCELLED);
+            CHECK(drag_action_t(ld, 1e9).set_move_tolerance(std::ceil(max_incorrect))
+                .update_state(state, motion) == ACTION_STATUS_RUNNING);
+        }
+
+        // A single finger is its own center, so it has no scale
+        if (cnt_fingers > 1)
+        {
+            CHECK(scales[1] == doctest::Approx(scales[0]));
+            CHECK(scales[2] == doctest::Approx(scales[0]));
+        }
+
+        CHECK(angles[1] == doctest::Approx(angles[0]));
+        CHECK(angles[2] == doctest::Approx(angles[0]));
+    }
+
+    set_simd_level(supported);
+}
+
+TEST_CASE("gesture_state_t::get_finger_arrays follows the fingers")
+{
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<double> coord(-500, 500);
+    gesture_state_t state;
+
+    auto check_arrays = [&] ()
+    {
+        const finger_soa_t& arrays = state.get_finger_arrays();
+        REQUIRE(arrays.count == state.fingers.size());
+        size_t i = 0;
+        for (auto& f : state.fingers)
+        {
+            CHECK(arrays.origin_x[i] == f.second.origin.x);
+            CHECK(arrays.origin_y[i] == f.second.origin.y);
+            CHECK(arrays.current_x[i] == f.second.current.x);
+            CHECK(arrays.current_y[i] == f.second.current.y);
+            ++i;
+        }
+    };
+
+    for (int step = 0; step < 2000; step++)
+    {
+        gesture_event_t ev{.time = (uint32_t)step};
+        ev.finger = gen() % 30;
+        ev.pos = {coord(gen), coord(gen)};
+        switch (gen() % 8)
+        {
+          case 0:
+          case 1:
+            ev.type = EVENT_TYPE_TOUCH_DOWN;
+            break;
+
+          case 2:
+            ev.type = EVENT_TYPE_TOUCH_UP;
+            break;
+
+          case 3:
+            state.reset_origin();
+            check_arrays();
+            continue;
+
+          case 4:
+            // modified directly, not through update()
+            if (!state.fingers.full())
+            {
+                state.fingers[ev.finger] = finger_2p(ev.pos.x, ev.pos.y, 0, 0);
+            }
+
+            continue;
+
+          default:
+            ev.type = EVENT_TYPE_MOTION;
+            break;
+        }
+
+        state.update(ev);
+        check_arrays();
+    }
+}
@@ -0,0 +1,706 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <wayfire/touch/gesture-set.hpp>
+#include "../src/target-index.hpp"
+#include <algorithm>
+#include <random>
+
+using namespace wf::touch;
+
+class fake_timer_t : public timer_interface_t
+{
+  public:
+    std::function<void()> last_cb;
+
+    void set_timeout(uint32_t, std::function<void()> cb) override
+    {
+        last_cb = cb;
+    }
+
+    void reset() override
+    {
+        last_cb = nullptr;
+    }
+};
+
+static gesture_event_t touch_event(gesture_event_type_t type, int finger, double x, double y)
+{
+    return gesture_event_t{.type = type, .time = 0, .finger = finger, .pos = {x, y}};
+}
+
+TEST_CASE("wf::touch::gesture_set_t")
+{
+    int completed_twice = 0, completed_long = 0, completed_right = 0;
+    int cancelled_right = 0;
+
+    gesture_set_t set;
+    // Two consecutive drags, the second one measured from where the first ended
+    gesture_t twice = gesture_builder_t()
+        .action(touch_action_t(1, true))
+        .action(drag_action_t(MOVE_DIRECTION_LEFT, 10))
+        .action(drag_action_t(MOVE_DIRECTION_LEFT, 10))
+        .on_completed([&] () { ++completed_twice; })
+        .build();
+    gesture_t longer = gesture_builder_t()
+        .action(touch_action_t(1, true))
+        .action(drag_action_t(MOVE_DIRECTION_LEFT, 15))
+        .on_completed([&] () { ++completed_long; })
+        .build();
+    gesture_t right = gesture_builder_t()
+        .action(touch_action_t(1, true))
+        .action(drag_action_t(MOVE_DIRECTION_RIGHT, 10).set_move_tolerance(5))
+        .on_completed([&] () { ++completed_right; })
+        .on_cancelled([&] () { ++cancelled_right; })
+        .build();
+
+    twice.set_timer(std::make_unique<fake_timer_t>());
+    longer.set_timer(std::make_unique<fake_timer_t>());
+    right.set_timer(std::make_unique<fake_timer_t>());
+    auto& g_twice = set.add(std::move(twice));
+    auto& g_longer = set.add(std::move(longer));
+    auto& g_right = set.add(std::move(right));
+    CHECK(set.size() == 3);
+
+    set.reset(0);
+    set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 0, 0));
+    CHECK(set.get_state().fingers.size() == 1);
+
+    set.update_state(touch_event(EVENT_TYPE_MOTION, 0, -10, 0));
+    CHECK(g_twice.get_status() == ACTION_STATUS_RUNNING);
+    CHECK(g_twice.get_progress() == doctest::Approx(2.0 / 3.0));
+    CHECK(g_right.get_status() == ACTION_STATUS_CANCELLED);
+    CHECK(cancelled_right == 1);
+
+    // Only the first gesture has reset its origin, the second one still
+    // measures from the touch down point.
+    set.update_state(touch_event(EVENT_TYPE_MOTION, 0, -16, 0));
+    CHECK(completed_long == 1);
+    CHECK(completed_twice == 0);
+    CHECK(g_twice.get_status() == ACTION_STATUS_RUNNING);
+
+    set.update_state(touch_event(EVENT_TYPE_MOTION, 0, -20, 0));
+    CHECK(completed_twice == 1);
+    CHECK(g_longer.get_status() == ACTION_STATUS_COMPLETED);
+    CHECK(set.get_state().fingers.find(0)->second.current == point_t{-20, 0});
+
+    SUBCASE("restart")
+    {
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_UP, 0, -20, 0));
+        set.reset(100);
+        CHECK(set.get_state().fingers.empty());
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 0, 0));
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 10, 0));
+        CHECK(completed_right == 1);
+        CHECK(cancelled_right == 1);
+    }
+
+    SUBCASE("batch")
+    {
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_UP, 0, -20, 0));
+        set.reset(100);
+        std::vector<gesture_event_t> events = {
+            touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 0, 0),
+            touch_event(EVENT_TYPE_MOTION, 0, 10, 0),
+            touch_event(EVENT_TYPE_MOTION, 0, 20, 0),
+            touch_event(EVENT_TYPE_TOUCH_DOWN, 1, 5, 5),
+        };
+
+        set.update_state(events.data(), events.size());
+        CHECK(completed_right == 1);
+        CHECK(g_twice.get_status() == ACTION_STATUS_CANCELLED);
+        CHECK(set.get_state().fingers.size() == 2);
+    }
+
+    SUBCASE("coalesce motion")
+    {
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_UP, 0, -20, 0));
+        set.set_coalesce_motion(true);
+        set.reset(100);
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 0, 0));
+        for (int i = 1; i <= 20; i++)
+        {
+            set.update_state(touch_event(EVENT_TYPE_MOTION, 0, i, 0));
+        }
+
+        // nothing is processed until the end of the frame
+        CHECK(set.get_state().fingers.find(0)->second.current == point_t{0, 0});
+        CHECK(completed_right == 0);
+
+        set.frame();
+        CHECK(set.get_state().fingers.find(0)->second.current == point_t{20, 0});
+        CHECK(completed_right == 1);
+        CHECK(g_twice.get_status() == ACTION_STATUS_RUNNING);
+
+        // a touch up processes pending motion first
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 25, 0));
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_UP, 0, 25, 0));
+        CHECK(set.get_state().fingers.empty());
+    }
+
+    SUBCASE("remove")
+    {
+        set.remove(g_right);
+        CHECK(set.size() == 2);
+        set.reset(100);
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 0, 0));
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 10, 0));
+        CHECK(completed_right == 0);
+    }
+
+    SUBCASE("rebuild from the arena")
+    {
+        set.clear();
+        CHECK(set.size() == 0);
+
+        int completed_left = 0;
+        for (int i = 0; i < 2; i++)
+        {
+            for (int fingers = 1; fingers <= 4; fingers++)
+            {
+                set.add(gesture_builder_t(set.get_arena())
+                    .action(touch_action_t(fingers, true))
+                    .action(drag_action_t(MOVE_DIRECTION_LEFT, 10))
+                    .on_completed([&] () { ++completed_left; })
+                    .build());
+            }
+
+            CHECK(set.size() == 4);
+            set.reset(0);
+            set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 0, 0));
+            set.update_state(touch_event(EVENT_TYPE_MOTION, 0, -10, 0));
+            set.update_state(touch_event(EVENT_TYPE_TOUCH_UP, 0, -10, 0));
+            CHECK(completed_left == i + 1);
+            set.clear();
+        }
+    }
+}
+
+TEST_CASE("wf::touch::gesture_set_t delivers held back motion before timeouts")
+{
+    int completed = 0, cancelled = 0;
+    gesture_set_t set;
+    set.set_coalesce_motion(true);
+
+    auto motion = [] (double x, uint32_t time)
+    {
+        return gesture_event_t{.type = EVENT_TYPE_MOTION, .time = time, .finger = 0, .pos = {x, 0}};
+    };
+
+    SUBCASE("advance_time")
+    {
+        set.add(gesture_builder_t()
+            .action(touch_action_t(1, true))
+            .action(drag_action_t(MOVE_DIRECTION_RIGHT, 10).set_duration(100))
+            .on_completed([&] () { ++completed; })
+            .on_cancelled([&] () { ++cancelled; })
+            .build());
+
+        set.reset(0);
+        set.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 0, .pos = {0, 0}});
+        set.update_state(motion(20, 50));
+        CHECK(completed == 0);
+
+        // the drag completed at 50, before its deadline at 100
+        set.advance_time(150);
+        CHECK(completed == 1);
+        CHECK(cancelled == 0);
+    }
+
+    SUBCASE("timer")
+    {
+        auto timer = std::make_unique<fake_timer_t>();
+        auto timer_ptr = timer.get();
+        gesture_t drag = gesture_builder_t()
+            .action(touch_action_t(1, true))
+            .action(drag_action_t(MOVE_DIRECTION_RIGHT, 10).set_duration(100))
+            .action(hold_action_t(100))
+            .on_completed([&] () { ++completed; })
+            .on_cancelled([&] () { ++cancelled; })
+            .build();
+        drag.set_timer(std::move(timer));
+        auto& added = set.add(std::move(drag));
+
+        set.reset(0);
+        set.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 0, .pos = {0, 0}});
+        set.update_state(motion(20, 50));
+        REQUIRE(timer_ptr->last_cb);
+
+        // the drag timeout runs the held back motion first, which completes
+        // the drag and starts the hold, so the timeout itself is stale
+        auto drag_timeout = timer_ptr->last_cb;
+        drag_timeout();
+        CHECK(cancelled == 0);
+        CHECK(added.get_status() == ACTION_STATUS_RUNNING);
+        CHECK(added.get_progress() == doctest::Approx(2.0 / 3.0));
+
+        timer_ptr->last_cb();
+        CHECK(completed == 1);
+    }
+}
+
+TEST_CASE("wf::touch::gesture_set_t shares the finger state until the first action completes")
+{
+    gesture_set_t set;
+    std::vector<std::pair<size_t, const gesture_state_t*>> states;
+    std::vector<double> set_progress, progress;
+
+    auto make_gesture = [] (std::vector<double>& progress)
+    {
+        // the flick needs the finger history, which the other gesture does not
+        return gesture_builder_t()
+            .action(touch_action_t(1, true))
+            .action(flick_action_t(MOVE_DIRECTION_RIGHT, 0.5))
+            .on_update([&progress] (const gesture_update_t& update)
+            {
+                progress.push_back(update.progress);
+            })
+            .build();
+    };
+
+    auto& flick = set.add(make_gesture(set_progress));
+    flick.set_update_callback([&] (const gesture_update_t& update)
+    {
+        states.push_back({update.action, &update.state});
+        set_progress.push_back(update.progress);
+    });
+    set.add(gesture_builder_t()
+        .action(touch_action_t(1, true))
+        .action(drag_action_t(MOVE_DIRECTION_LEFT, 100))
+        .build());
+
+    auto alone = make_gesture(progress);
+    set.reset(0);
+    alone.reset(0);
+    // an accelerating finger, which flicks after a few events
+    for (uint32_t time = 0; time <= 100; time += 10)
+    {
+        gesture_event_t ev{.type = time ? EVENT_TYPE_MOTION : EVENT_TYPE_TOUCH_DOWN,
+            .time = time, .finger = 0, .pos = {time * time / 100.0, 0}};
+        set.update_state(ev);
+        alone.update_state(ev);
+    }
+
+    CHECK(flick.get_status() == ACTION_STATUS_COMPLETED);
+    CHECK(alone.get_status() == ACTION_STATUS_COMPLETED);
+    REQUIRE(set_progress.size() == progress.size());
+    for (size_t i = 0; i < progress.size(); i++)
+    {
+        CHECK(set_progress[i] == doctest::Approx(progress[i]));
+    }
+
+    REQUIRE(states.size() > 2);
+    CHECK(states[0] == std::make_pair(size_t(0), &set.get_state()));
+    CHECK(states.back().first == 1);
+    CHECK(states.back().second != &set.get_state());
+}
+
+TEST_CASE("wf::touch::gesture_set_t keeps the fingers of gestures running across a reset")
+{
+    gesture_set_t set;
+    auto& drag = set.add(gesture_builder_t()
+        .action(touch_action_t(1, true))
+        .action(drag_action_t(MOVE_DIRECTION_RIGHT, 20))
+        .build());
+
+    set.reset(0);
+    set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 0, 0));
+    set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 5, 0));
+    CHECK(drag.get_status() == ACTION_STATUS_RUNNING);
+
+    // The set forgets the finger, the running drag does not
+    set.reset(0);
+    CHECK(set.get_state().fingers.empty());
+    set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 30, 0));
+    CHECK(drag.get_status() == ACTION_STATUS_COMPLETED);
+}
+
+/** An action which completes when it times out, whatever the fingers do. */
+class wait_action_t : public gesture_action_t
+{
+  public:
+    wait_action_t(uint32_t duration)
+    {
+        set_duration(duration);
+    }
+
+    action_status_t update_state(const gesture_state_t&, const gesture_event_t& event) override
+    {
+        return (event.type == EVENT_TYPE_TIMEOUT) ? ACTION_STATUS_COMPLETED : ACTION_STATUS_RUNNING;
+    }
+};
+
+TEST_CASE("wf::touch::gesture_set_t expires deadlines before the event")
+{
+    auto make_gesture = [] ()
+    {
+        return gesture_builder_t()
+            .action(wait_action_t(50))
+            .action(drag_action_t(MOVE_DIRECTION_RIGHT, 20))
+            .build();
+    };
+
+    gesture_set_t set;
+    auto& drag = set.add(make_gesture());
+    auto alone = make_gesture();
+    set.reset(0);
+    alone.reset(0);
+
+    // The wait times out right before the motion, so the drag starts from
+    // the position before it
+    const gesture_event_t events[] = {
+        {.type = EVENT_TYPE_TOUCH_DOWN, .time = 10, .finger = 0, .pos = {0, 0}},
+        {.type = EVENT_TYPE_MOTION, .time = 60, .finger = 0, .pos = {30, 0}},
+    };
+
+    for (auto& ev : events)
+    {
+        set.update_state(ev);
+        alone.update_state(ev);
+    }
+
+    CHECK(alone.get_status() == ACTION_STATUS_COMPLETED);
+    CHECK(drag.get_status() == ACTION_STATUS_COMPLETED);
+}
+
+TEST_CASE("wf::touch::gesture_set_t behaves like independent gestures")
+{
+    // gestures with various first actions, some of which the set does not
+    // evaluate for some touch events
+    auto make_gestures = [] (std::vector<int>& completed, std::vector<int>& cancelled)
+    {
+        // spanning several cells of the set's target index
+        const touch_target_t left = {0, 0, 150, 300};
+        const touch_target_t right = {150, 0, 150, 300};
+        const touch_target_t middle = {100, 100, 100, 100};
+
+        std::vector<gesture_builder_t> builders;
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(1, true).set_target(left))
+            .action(drag_action_t(MOVE_DIRECTION_RIGHT, 20))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(2, true).set_target(right))
+            .action(drag_action_t(MOVE_DIRECTION_LEFT, 20))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(2, true))
+            .action(touch_action_t(2, false))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(1, false).set_target(left))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(hold_action_t(30))
+            .action(touch_action_t(1, true))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(1, true).set_target(middle))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(1, true).set_move_tolerance(10).set_duration(50))
+            .action(touch_action_t(1, true).set_target(right))));
+
+        completed.assign(builders.size(), 0);
+        cancelled.assign(builders.size(), 0);
+
+        std::vector<gesture_t> gestures;
+        for (size_t i = 0; i < builders.size(); i++)
+        {
+            gestures.push_back(std::move(builders[i])
+                .on_completed([&completed, i] () { ++completed[i]; })
+                .on_cancelled([&cancelled, i] () { ++cancelled[i]; })
+                .build());
+        }
+
+        return gestures;
+    };
+
+    std::vector<int> set_completed, set_cancelled;
+    std::vector<int> completed, cancelled;
+    gesture_set_t set;
+    for (auto& g : make_gestures(set_completed, set_cancelled))
+    {
+        set.add(std::move(g));
+    }
+
+    auto gestures = make_gestures(completed, cancelled);
+
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> coord(0, 299);
+    uint32_t time = 0;
+    auto update_all = [&] (const gesture_event_t& ev)
+    {
+        set.update_state(ev);
+        for (auto& g : gestures)
+        {
+            g.update_state(ev);
+        }
+    };
+
+    for (int round = 0; round < 500; round++)
+    {
+        std::vector<int> down;
+        set.reset(time);
+        for (auto& g : gestures)
+        {
+            g.reset(time);
+        }
+
+        for (int step = 0; step < 8; step++)
+        {
+            time += gen() % 20;
+            gesture_event_t ev{.time = time};
+            const int action = gen() % 3;
+            if ((action == 0) && (down.size() < 3))
+            {
+                ev.type = EVENT_TYPE_TOUCH_DOWN;
+                ev.finger = round * 10 + step;
+                down.push_back(ev.finger);
+            } else if (down.empty())
+            {
+                continue;
+            } else
+            {
+                const size_t idx = gen() % down.size();
+                ev.finger = down[idx];
+                ev.type = (action == 1) ? EVENT_TYPE_MOTION : EVENT_TYPE_TOUCH_UP;
+                if (ev.type == EVENT_TYPE_TOUCH_UP)
+                {
+                    down.erase(down.begin() + idx);
+                }
+            }
+
+            ev.pos = {1.0 * coord(gen), 1.0 * coord(gen)};
+            update_all(ev);
+        }
+
+        for (int finger : down)
+        {
+            update_all({.type = EVENT_TYPE_TOUCH_UP, .time = time, .finger = finger,
+                .pos = {1.0 * coord(gen), 1.0 * coord(gen)}});
+        }
+
+        set.advance_time(time + 100);
+        for (auto& g : gestures)
+        {
+            g.advance_time(time + 100);
+        }
+
+        REQUIRE(set_completed == completed);
+        REQUIRE(set_cancelled == cancelled);
+        time += 1000;
+    }
+
+    // make sure the scenarios are not all trivial. Recognition always starts
+    // without fingers, so the gesture starting with a touch up never completes.
+    for (size_t i = 0; i < completed.size(); i++)
+    {
+        CHECK((completed[i] > 0) == (i != 3));
+        CHECK(cancelled[i] > 0);
+    }
+}
+
+TEST_CASE("wf::touch::gesture_set_t with many targets")
+{
+    // left and right edges of two outputs side by side
+    const touch_target_t edges[] = {
+        {-1920, 0, 20, 1080}, {-20, 0, 20, 1080}, {0, 0, 20, 1080}, {1900, 0, 20, 1080},
+    };
+
+    std::vector<int> completed(4, 0);
+    gesture_set_t set;
+    for (int i = 0; i < 4; i++)
+    {
+        set.add(gesture_builder_t()
+            .action(touch_action_t(1, true).set_target(edges[i]))
+            .on_completed([&completed, i] () { ++completed[i]; })
+            .build());
+    }
+
+    auto tap = [&] (double x, double y)
+    {
+        set.reset(0);
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, x, y));
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_UP, 0, x, y));
+    };
+
+    tap(0, 500);
+    CHECK(completed == std::vector<int>{0, 0, 1, 0});
+    tap(-0.5, 1079.5);
+    CHECK(completed == std::vector<int>{0, 1, 1, 0});
+    tap(-1920, 0);
+    CHECK(completed == std::vector<int>{1, 1, 1, 0});
+    tap(1920, 500);
+    CHECK(completed == std::vector<int>{1, 1, 1, 0});
+    tap(1919.9, 1080);
+    CHECK(completed == std::vector<int>{1, 1, 1, 0});
+    tap(1919.9, 0);
+    CHECK(completed == std::vector<int>{1, 1, 1, 1});
+
+    set.remove(set.add(gesture_builder_t()
+        .action(touch_action_t(1, true).set_target(edges[3]))
+        .on_completed([&] () { ++completed[0]; })
+        .build()));
+    tap(1919.9, 0);
+    CHECK(completed == std::vector<int>{1, 1, 1, 2});
+}
+
+TEST_CASE("wf::touch::target_index_t with edge strips")
+{
+    // the edges of a wide output, which span more cells than a target in
+    // the grid may
+    const touch_target_t targets[] = {
+        {0, 0, 5120, 20}, {0, 1420, 5120, 20}, {0, 0, 20, 1440}, {5100, 0, 20, 1440},
+        {-1e9, -1e9, 2e9, 2e9},
+    };
+
+    target_index_t<int> index;
+    for (int i = 0; i < 5; i++)
+    {
+        index.insert(targets[i], i);
+    }
+
+    // only the target covering everything is tested by every query
+    CHECK(index.count_unindexed() == 1);
+
+    auto query = [&] (double x, double y)
+    {
+        std::vector<int> found;
+        index.query({x, y}, [&] (int key) { found.push_back(key); });
+        std::sort(found.begin(), found.end());
+        return found;
+    };
+
+    CHECK(query(2560, 10) == std::vector<int>{0, 4});
+    CHECK(query(5119, 1439) == std::vector<int>{1, 3, 4});
+    CHECK(query(0, 0) == std::vector<int>{0, 2, 4});
+    CHECK(query(10, 720) == std::vector<int>{2, 4});
+    CHECK(query(2560, 720) == std::vector<int>{4});
+    CHECK(query(5120, 10) == std::vector<int>{4});
+
+    index.erase(targets[0], 0);
+    index.erase(targets[3], 3);
+    CHECK(query(2560, 10) == std::vector<int>{4});
+    CHECK(query(5110, 1430) == std::vector<int>{1, 4});
+}
+
+/** An action which runs until a number of events, then cannot complete anymore. */
+class give_up_action_t : public gesture_action_t
+{
+  public:
+    give_up_action_t(int events, int *seen) : events(events), seen(seen) {}
+
+    action_status_t update_state(const gesture_state_t&, const gesture_event_t&) override
+    {
+        ++*seen;
+        return ACTION_STATUS_RUNNING;
+    }
+
+    void reset(uint32_t time) override
+    {
+        gesture_action_t::reset(time);
+        *seen = 0;
+    }
+
+    bool will_never_complete(const gesture_state_t&) const override
+    {
+        return *seen >= events;
+    }
+
+  private:
+    int events;
+    int *seen;
+};
+
+TEST_CASE("wf::touch::gesture_set_t conflict groups")
+{
+    std::vector<int> completed(6, 0), cancelled(6, 0);
+    int seen_low = 0, seen_high = 0;
+
+    gesture_set_t set;
+    auto add = [&] (int i, auto&& action)
+    {
+        return std::ref(set.add(gesture_builder_t()
+            .action(touch_action_t(1, true))
+            .action(std::move(action))
+            .on_completed([&completed, i] () { ++completed[i]; })
+            .on_cancelled([&cancelled, i] () { ++cancelled[i]; })
+            .build()));
+    };
+
+    gesture_t& short_left = add(0, drag_action_t(MOVE_DIRECTION_LEFT, 5).set_move_tolerance(100));
+    gesture_t& long_left = add(1, drag_action_t(MOVE_DIRECTION_LEFT, 10).set_move_tolerance(100));
+    gesture_t& down = add(2, drag_action_t(MOVE_DIRECTION_DOWN, 10).set_move_tolerance(100));
+    add(3, drag_action_t(MOVE_DIRECTION_LEFT, 5).set_move_tolerance(100));
+    gesture_t& low = add(4, give_up_action_t(3, &seen_low));
+    gesture_t& high = add(5, give_up_action_t(3, &seen_high));
+
+    SUBCASE("first completion cancels the rest of the group")
+    {
+        set.set_conflict_group(short_left, 0);
+        set.set_conflict_group(long_left, 0);
+        set.set_conflict_group(down, 0);
+
+        set.reset(0);
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 50, 50));
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 44, 50));
+        CHECK(completed == std::vector<int>{1, 0, 0, 1, 0, 0});
+        CHECK(cancelled == std::vector<int>{0, 1, 1, 0, 0, 0});
+
+        // The losers stay cancelled, the gesture outside of the group was
+        // not affected
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 30, 70));
+        CHECK(completed == std::vector<int>{1, 0, 0, 1, 0, 0});
+
+        // Without the group, all gestures run independently again
+        set.set_conflict_group(long_left, -1);
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_UP, 0, 30, 70));
+        set.reset(0);
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 50, 50));
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 30, 50));
+        CHECK(completed == std::vector<int>{2, 1, 0, 2, 0, 0});
+        CHECK(cancelled == std::vector<int>{0, 1, 2, 0, 1, 1});
+    }
+
+    SUBCASE("priority decides between completions on the same event")
+    {
+        set.set_conflict_group(short_left, 0, 0);
+        set.set_conflict_group(long_left, 0, 1);
+        set.set_conflict_group(low, 1, 0);
+        set.set_conflict_group(high, 1, 1);
+
+        set.reset(0);
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 50, 50));
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 30, 50));
+        CHECK(completed[0] == 0);
+        CHECK(completed[1] == 1);
+        CHECK(cancelled[0] == 1);
+    }
+
+    SUBCASE("losers are not evaluated anymore")
+    {
+        // The completion of the short drag prunes the lower priority gesture
+        // before it sees the event, but not the higher priority one.
+        set.set_conflict_group(short_left, 0, 1);
+        set.set_conflict_group(low, 0, 0);
+        set.set_conflict_group(high, 0, 2);
+
+        set.reset(0);
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 50, 50));
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 44, 50));
+        CHECK(seen_low == 0);
+        CHECK(seen_high == 1);
+        CHECK(completed[0] == 1);
+        CHECK(cancelled[4] == 1);
+        CHECK(cancelled[5] == 1);
+    }
+
+    SUBCASE("actions which will never complete cancel their gesture")
+    {
+        set.reset(0);
+        set.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 50, 50));
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 50, 51));
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 50, 52));
+        CHECK(cancelled[4] == 0);
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 50, 53));
+        CHECK(cancelled[4] == 1);
+        CHECK(cancelled[5] == 1);
+
+        set.update_state(touch_event(EVENT_TYPE_MOTION, 0, 50, 54));
+        CHECK(seen_low == 3);
+    }
+}
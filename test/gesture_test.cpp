@@ -184,4 +184,269 @@ TEST_CASE("wf::touch::gesture_t")
             CHECK(completed == 0);
         }
     }
+
+    SUBCASE("batch")
+    {
+        gesture_t swipe = gesture_builder_t()
+            .action(touch_action_t(1, true))
+            .action(drag_action_t(MOVE_DIRECTION_LEFT, 10))
+            .on_completed(callback1)
+            .on_cancelled(callback2)
+            .build();
+        swipe.set_timer(std::move(_timer));
+        swipe.reset(0);
+
+        std::vector<gesture_event_t> events = {
+            {.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 0, .pos = {0, 0}},
+            {.type = EVENT_TYPE_MOTION, .time = 5, .finger = 0, .pos = {-5, 0}},
+            {.type = EVENT_TYPE_MOTION, .time = 10, .finger = 0, .pos = {-10, 0}},
+            {.type = EVENT_TYPE_MOTION, .time = 15, .finger = 0, .pos = {-15, 0}},
+        };
+
+        CHECK(swipe.update_state(events.data(), 2) == 2);
+        CHECK(swipe.get_status() == ACTION_STATUS_RUNNING);
+        CHECK(swipe.update_state(events.data() + 2, 2) == 1);
+        CHECK(completed == 1);
+        CHECK(cancelled == 0);
+        CHECK(swipe.update_state(events.data(), events.size()) == 0);
+    }
+}
+
+TEST_CASE("wf::touch::gesture_t without a timer")
+{
+    int completed = 0;
+    int cancelled = 0;
+
+    // touch down, hold for 100ms, then lift within 200ms
+    gesture_t hold = gesture_builder_t()
+        .action(touch_action_t(1, true).set_duration(50))
+        .action(hold_action_t(100))
+        .action(touch_action_t(1, false).set_duration(200))
+        .on_completed([&] () { ++completed; })
+        .on_cancelled([&] () { ++cancelled; })
+        .build();
+
+    hold.reset(1000);
+    hold.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 1000, .finger = 0, .pos = {0, 0}});
+    CHECK(hold.get_progress() == doctest::Approx(1.0 / 3.0));
+
+    SUBCASE("timeouts from event times")
+    {
+        hold.update_state({.type = EVENT_TYPE_MOTION, .time = 1099, .finger = 0, .pos = {0, 0}});
+        CHECK(hold.get_progress() == doctest::Approx(1.0 / 3.0));
+
+        // the hold times out right before this event, which then counts for
+        // the touch up action
+        hold.update_state({.type = EVENT_TYPE_TOUCH_UP, .time = 1150, .finger = 0, .pos = {0, 0}});
+        CHECK(completed == 1);
+        CHECK(cancelled == 0);
+    }
+
+    SUBCASE("several timeouts before one event")
+    {
+        // hold completes at 1100, touch up times out at 1300
+        hold.update_state({.type = EVENT_TYPE_TOUCH_UP, .time = 1300, .finger = 0, .pos = {0, 0}});
+        CHECK(completed == 0);
+        CHECK(cancelled == 1);
+    }
+
+    SUBCASE("advance_time")
+    {
+        hold.advance_time(1099);
+        CHECK(hold.get_progress() == doctest::Approx(1.0 / 3.0));
+        hold.advance_time(1100);
+        CHECK(hold.get_progress() == doctest::Approx(2.0 / 3.0));
+        hold.advance_time(1299);
+        CHECK(hold.get_status() == ACTION_STATUS_RUNNING);
+        hold.advance_time(1300);
+        CHECK(cancelled == 1);
+    }
+
+    SUBCASE("first action times out")
+    {
+        gesture_t tap = gesture_builder_t()
+            .action(touch_action_t(2, true).set_duration(50))
+            .on_completed([&] () { ++completed; })
+            .on_cancelled([&] () { ++cancelled; })
+            .build();
+        tap.reset(0);
+        tap.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 0, .pos = {0, 0}});
+        tap.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 60, .finger = 1, .pos = {0, 0}});
+        CHECK(completed == 0);
+        CHECK(cancelled == 1);
+    }
+}
+
+/** An action which completes on the n-th event it sees. */
+class count_action_t : public gesture_action_t
+{
+  public:
+    count_action_t(int events) : events(events) {}
+
+    action_status_t update_state(const gesture_state_t&, const gesture_event_t&) override
+    {
+        return (++seen >= events) ? ACTION_STATUS_COMPLETED : ACTION_STATUS_RUNNING;
+    }
+
+    void reset(uint32_t time) override
+    {
+        gesture_action_t::reset(time);
+        seen = 0;
+    }
+
+  private:
+    int events;
+    int seen = 0;
+};
+
+TEST_CASE("wf::touch::gesture_t action storage")
+{
+    int completed = 0;
+    int cancelled = 0;
+
+    SUBCASE("built-in actions are stored inline")
+    {
+        action_storage_t inline_action{std::in_place_type<touch_action_t>, 1, true};
+        CHECK(&get_action(inline_action) == &std::get<touch_action_t>(inline_action));
+    }
+
+    SUBCASE("custom actions mixed with built-in ones")
+    {
+        gesture_t gesture = gesture_builder_t()
+            .action(touch_action_t(1, true))
+            .action(count_action_t(2))
+            .action(touch_action_t(1, false))
+            .on_completed([&] () { ++completed; })
+            .on_cancelled([&] () { ++cancelled; })
+            .build();
+
+        gesture.reset(0);
+        gesture.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 0, .pos = {0, 0}});
+        CHECK(gesture.get_progress() == doctest::Approx(1.0 / 3.0));
+        gesture.update_state({.type = EVENT_TYPE_MOTION, .time = 10, .finger = 0, .pos = {1, 0}});
+        CHECK(gesture.get_progress() == doctest::Approx(1.0 / 3.0));
+        gesture.update_state({.type = EVENT_TYPE_MOTION, .time = 20, .finger = 0, .pos = {2, 0}});
+        CHECK(gesture.get_progress() == doctest::Approx(2.0 / 3.0));
+        gesture.update_state({.type = EVENT_TYPE_TOUCH_UP, .time = 30, .finger = 0, .pos = {2, 0}});
+        CHECK(completed == 1);
+        CHECK(cancelled == 0);
+    }
+
+    SUBCASE("unique_ptr constructor")
+    {
+        std::vector<std::unique_ptr<gesture_action_t>> actions;
+        actions.push_back(std::make_unique<touch_action_t>(1, true));
+        actions.push_back(std::make_unique<count_action_t>(1));
+        gesture_t gesture{std::move(actions), [&] () { ++completed; }, [&] () { ++cancelled; }};
+
+        gesture.reset(0);
+        gesture.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 0, .pos = {0, 0}});
+        gesture.update_state({.type = EVENT_TYPE_MOTION, .time = 10, .finger = 0, .pos = {1, 0}});
+        CHECK(completed == 1);
+        CHECK(cancelled == 0);
+    }
+}
+
+TEST_CASE("wf::touch::gesture_t with action groups")
+{
+    int completed = 0;
+    int cancelled = 0;
+    gesture_t double_tap = gesture_builder_t()
+        .action(repeat_action_t(2)
+            .action(touch_action_t(1, true).set_duration(100))
+            .action(touch_action_t(1, false).set_duration(100)))
+        .on_completed([&] () { ++completed; })
+        .on_cancelled([&] () { ++cancelled; })
+        .build();
+
+    auto tap = [&] (uint32_t time)
+    {
+        double_tap.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = time, .finger = 0, .pos = {0, 0}});
+        double_tap.update_state({.type = EVENT_TYPE_TOUCH_UP, .time = time + 50, .finger = 0, .pos = {0, 0}});
+    };
+
+    double_tap.reset(0);
+    tap(0);
+    CHECK(double_tap.get_status() == ACTION_STATUS_RUNNING);
+
+    SUBCASE("quick")
+    {
+        tap(100);
+        CHECK(completed == 1);
+        CHECK(cancelled == 0);
+    }
+
+    SUBCASE("slow")
+    {
+        tap(200);
+        CHECK(completed == 0);
+        CHECK(cancelled == 1);
+    }
+}
+
+TEST_CASE("wf::touch::gesture_t update callback")
+{
+    int completed = 0;
+    std::vector<std::pair<size_t, double>> updates;
+    gesture_t swipe = gesture_builder_t()
+        .action(touch_action_t(2, true))
+        .action(drag_action_t(MOVE_DIRECTION_LEFT, 100).set_move_tolerance(20))
+        .on_completed([&] () { ++completed; })
+        .on_update([&] (const gesture_update_t& update)
+        {
+            updates.push_back({update.action, update.progress});
+        })
+        .build();
+
+    swipe.reset(0);
+    swipe.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 0, .pos = {100, 0}});
+    swipe.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 1, .pos = {100, 10}});
+    using update_t = std::pair<size_t, double>;
+    CHECK(updates == std::vector<update_t>{{0, 0.0}, {0, 0.0}});
+    updates.clear();
+
+    auto move = [&] (double x)
+    {
+        swipe.update_state({.type = EVENT_TYPE_MOTION, .time = 10, .finger = 0, .pos = {x, 0}});
+        swipe.update_state({.type = EVENT_TYPE_MOTION, .time = 10, .finger = 1, .pos = {x, 10}});
+    };
+
+    SUBCASE("complete")
+    {
+        move(90);
+        move(50);
+        move(0);
+        CHECK(completed == 1);
+        CHECK(updates == std::vector<update_t>{{1, 0.05}, {1, 0.1}, {1, 0.3}, {1, 0.5},
+            {1, 0.75}, {1, 1.0}});
+    }
+
+    SUBCASE("no update when cancelled")
+    {
+        move(110);
+        CHECK(updates.size() == 2);
+        CHECK(updates.back().second == 0.0);
+        swipe.update_state({.type = EVENT_TYPE_TOUCH_UP, .time = 20, .finger = 0, .pos = {110, 0}});
+        CHECK(swipe.get_status() == ACTION_STATUS_CANCELLED);
+        CHECK(updates.size() == 2);
+    }
+}
+
+TEST_CASE("wf::touch::gesture_t cancels actions which will never complete")
+{
+    int cancelled = 0;
+    gesture_t gesture = gesture_builder_t()
+        .action(touch_action_t(1, true))
+        .action(touch_action_t(1, true).set_target({0, 0, 10, 10}))
+        .on_cancelled([&] () { ++cancelled; })
+        .build();
+
+    gesture.reset(0);
+    gesture.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 0, .pos = {20, 20}});
+    CHECK(gesture.get_status() == ACTION_STATUS_RUNNING);
+
+    // the first finger is outside of the target of the second touch down
+    gesture.update_state({.type = EVENT_TYPE_MOTION, .time = 10, .finger = 0, .pos = {20, 21}});
+    CHECK(gesture.get_status() == ACTION_STATUS_CANCELLED);
+    CHECK(cancelled == 1);
 }
@@ -0,0 +1,240 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <wayfire/touch/gesture-trie.hpp>
+#include <random>
+
+using namespace wf::touch;
+
+static gesture_event_t touch_event(gesture_event_type_t type, int finger, double x, double y,
+    uint32_t time = 0)
+{
+    return gesture_event_t{.type = type, .time = time, .finger = finger, .pos = {x, y}};
+}
+
+TEST_CASE("wf::touch::gesture_trie_t")
+{
+    int completed[4] = {0, 0, 0, 0};
+    int cancelled[4] = {0, 0, 0, 0};
+    const uint32_t directions[4] = {
+        MOVE_DIRECTION_LEFT, MOVE_DIRECTION_RIGHT, MOVE_DIRECTION_UP, MOVE_DIRECTION_DOWN,
+    };
+
+    gesture_trie_t trie;
+    for (int i = 0; i < 4; i++)
+    {
+        trie.add(gesture_builder_t()
+            .action(touch_action_t(2, true))
+            .action(drag_action_t(directions[i], 10).set_move_tolerance(5))
+            .on_completed([&completed, i] () { ++completed[i]; })
+            .on_cancelled([&cancelled, i] () { ++cancelled[i]; })
+            .build());
+    }
+
+    CHECK(trie.size() == 4);
+    CHECK(trie.count_actions() == 5);
+
+    trie.reset(0);
+    CHECK(trie.is_running());
+    trie.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 0, 0));
+    trie.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 1, 0, 10));
+
+    SUBCASE("swipe left")
+    {
+        trie.update_state(touch_event(EVENT_TYPE_MOTION, 0, -4, 0));
+        CHECK(trie.is_running());
+        trie.update_state(touch_event(EVENT_TYPE_MOTION, 0, -10, 0));
+        CHECK(cancelled[0] == 0);
+        CHECK(cancelled[1] + cancelled[2] + cancelled[3] == 3);
+        trie.update_state(touch_event(EVENT_TYPE_MOTION, 1, -10, 10));
+        CHECK(completed[0] == 1);
+        CHECK(completed[1] + completed[2] + completed[3] == 0);
+        CHECK(!trie.is_running());
+    }
+
+    SUBCASE("third finger")
+    {
+        trie.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 2, 0, 20));
+        for (int i = 0; i < 4; i++)
+        {
+            CHECK(cancelled[i] == 1);
+        }
+
+        CHECK(!trie.is_running());
+        trie.reset(100);
+        CHECK(trie.is_running());
+    }
+
+    SUBCASE("reset while running")
+    {
+        trie.reset(100);
+        trie.update_state(touch_event(EVENT_TYPE_MOTION, 0, 0, 20));
+        trie.update_state(touch_event(EVENT_TYPE_MOTION, 1, 0, 30));
+        CHECK(completed[3] == 1);
+    }
+
+    SUBCASE("add while running")
+    {
+        int added_completed = 0;
+        trie.add(gesture_builder_t()
+            .action(touch_action_t(2, true))
+            .action(drag_action_t(MOVE_DIRECTION_LEFT, 5).set_move_tolerance(5))
+            .on_completed([&] () { ++added_completed; })
+            .build());
+        CHECK(trie.size() == 5);
+        CHECK(trie.count_actions() == 5);
+
+        // Not part of the running recognition
+        trie.update_state(touch_event(EVENT_TYPE_MOTION, 0, -10, 0));
+        trie.update_state(touch_event(EVENT_TYPE_MOTION, 1, -10, 10));
+        CHECK(completed[0] == 1);
+        CHECK(added_completed == 0);
+        CHECK(!trie.is_running());
+
+        trie.reset(100);
+        CHECK(trie.count_actions() == 6);
+        trie.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 0, 0, 0, 100));
+        trie.update_state(touch_event(EVENT_TYPE_TOUCH_DOWN, 1, 0, 10, 100));
+        trie.update_state(touch_event(EVENT_TYPE_MOTION, 0, -10, 0, 110));
+        trie.update_state(touch_event(EVENT_TYPE_MOTION, 1, -10, 10, 110));
+        CHECK(added_completed == 1);
+        CHECK(completed[0] == 2);
+    }
+}
+
+TEST_CASE("wf::touch::gesture_trie_t behaves like independent gestures")
+{
+    // all actions have a duration, so that all gestures stop in each round
+    auto make_gestures = [] (std::vector<int>& completed, std::vector<int>& cancelled,
+                             std::vector<int>& updates, std::vector<double>& progress)
+    {
+        std::vector<gesture_builder_t> builders;
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(1, true).set_duration(50))
+            .action(drag_action_t(MOVE_DIRECTION_RIGHT, 20).set_duration(100))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(1, true).set_duration(50))
+            .action(drag_action_t(MOVE_DIRECTION_LEFT, 20).set_duration(100))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(1, true).set_duration(50))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(1, true).set_duration(50))
+            .action(hold_action_t(30))
+            .action(touch_action_t(1, false).set_duration(100))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(1, true).set_duration(50))
+            .action(hold_action_t(30))
+            .action(drag_action_t(MOVE_DIRECTION_UP, 10).set_duration(100))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(2, true).set_duration(80))
+            .action(touch_action_t(2, false).set_duration(100))));
+        builders.push_back(std::move(gesture_builder_t()
+            .action(touch_action_t(2, true).set_duration(80))
+            .action(pinch_action_t(1.5).set_duration(100))));
+
+        completed.assign(builders.size(), 0);
+        cancelled.assign(builders.size(), 0);
+        updates.assign(builders.size(), 0);
+        progress.assign(builders.size(), 0);
+
+        std::vector<gesture_t> gestures;
+        for (size_t i = 0; i < builders.size(); i++)
+        {
+            builders[i]
+                .on_completed([&completed, i] () { ++completed[i]; })
+                .on_cancelled([&cancelled, i] () { ++cancelled[i]; });
+            if (i % 2)
+            {
+                // only some of the gestures sharing an action report updates
+                builders[i].on_update([&updates, &progress, i] (const gesture_update_t& update)
+                {
+                    updates[i] += 1 + 100 * update.action;
+                    progress[i] += update.progress;
+                });
+            }
+
+            gestures.push_back(builders[i].build());
+        }
+
+        return gestures;
+    };
+
+    std::vector<int> trie_completed, trie_cancelled, trie_updates;
+    std::vector<int> completed, cancelled, updates;
+    std::vector<double> trie_progress, progress;
+    gesture_trie_t trie;
+    for (auto& g : make_gestures(trie_completed, trie_cancelled, trie_updates, trie_progress))
+    {
+        trie.add(std::move(g));
+    }
+
+    CHECK(trie.count_actions() == 9);
+    auto gestures = make_gestures(completed, cancelled, updates, progress);
+
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> coord(0, 99);
+    uint32_t time = 0;
+    for (int round = 0; round < 500; round++)
+    {
+        trie.reset(time);
+        for (auto& g : gestures)
+        {
+            g.reset(time);
+        }
+
+        std::vector<int> down;
+        for (int step = 0; step < 8; step++)
+        {
+            time += gen() % 40;
+            gesture_event_t ev{.time = time};
+            const int action = gen() % 3;
+            if ((action == 0) && (down.size() < 3))
+            {
+                ev.type = EVENT_TYPE_TOUCH_DOWN;
+                ev.finger = round * 10 + step;
+                down.push_back(ev.finger);
+            } else if (down.empty())
+            {
+                continue;
+            } else
+            {
+                const size_t idx = gen() % down.size();
+                ev.finger = down[idx];
+                ev.type = (action == 1) ? EVENT_TYPE_MOTION : EVENT_TYPE_TOUCH_UP;
+                if (ev.type == EVENT_TYPE_TOUCH_UP)
+                {
+                    down.erase(down.begin() + idx);
+                }
+            }
+
+            ev.pos = {1.0 * coord(gen), 1.0 * coord(gen)};
+            trie.update_state(ev);
+            for (auto& g : gestures)
+            {
+                g.update_state(ev);
+            }
+        }
+
+        time += 1000;
+        trie.advance_time(time);
+        for (auto& g : gestures)
+        {
+            g.advance_time(time);
+        }
+
+        REQUIRE(!trie.is_running());
+        REQUIRE(trie_completed == completed);
+        REQUIRE(trie_cancelled == cancelled);
+        REQUIRE(trie_updates == updates);
+        for (size_t i = 0; i < progress.size(); i++)
+        {
+            REQUIRE(trie_progress[i] == doctest::Approx(progress[i]));
+        }
+    }
+
+    for (size_t i = 0; i < completed.size(); i++)
+    {
+        CHECK(completed[i] > 0);
+        CHECK(cancelled[i] > 0);
+        CHECK((updates[i] > 0) == (i % 2 == 1));
+    }
+}
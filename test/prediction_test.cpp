@@ -0,0 +1,178 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <wayfire/touch/trace.hpp>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <unistd.h>
+
+using namespace wf::touch;
+
+/** The time between two events of the recorded traces, as on a 125Hz screen. */
+static constexpr uint32_t EVENT_INTERVAL = 8;
+
+/** How far ahead the positions are predicted, about one frame of latency. */
+static constexpr uint32_t LATENCY = 16;
+
+/** A temporary file, removed at the end of the test. */
+struct temp_file_t
+{
+    std::string path;
+    temp_file_t()
+    {
+        char name[] = "/tmp/wf-touch-prediction-XXXXXX";
+        int fd = mkstemp(name);
+        REQUIRE(fd >= 0);
+        close(fd);
+        path = name;
+    }
+
+    ~temp_file_t()
+    {
+        unlink(path.c_str());
+    }
+};
+
+/**
+ * Record the motion of one finger, with some noise, to a trace file as an
+ * input device would deliver it.
+ *
+ * @param path The path of the trace file.
+ * @param motion The position of the finger at a given time in milliseconds.
+ * @param duration The duration of the motion.
+ */
+static void record_trace(const std::string& path, std::function<point_t(double)> motion,
+    uint32_t duration)
+{
+    std::mt19937 gen{42};
+    std::uniform_real_distribution<double> noise{-0.5, 0.5};
+
+    trace_writer_t writer{path, 4};
+    REQUIRE(writer.is_open());
+    writer.record({EVENT_TYPE_TOUCH_DOWN, 1000, 0, motion(0)});
+    for (uint32_t t = EVENT_INTERVAL; t <= duration; t += EVENT_INTERVAL)
+    {
+        writer.record({EVENT_TYPE_MOTION, 1000 + t, 0,
+            motion(t) + point_t{noise(gen), noise(gen)}});
+    }
+
+    writer.record({EVENT_TYPE_TOUCH_UP, 1000 + duration, 0, motion(duration)});
+}
+
+/**
+ * Replay a trace into a gesture state, predicting the position of the finger
+ * LATENCY milliseconds after each event. The predictions are compared with
+ * the position which was actually recorded at that time.
+ *
+ * @return The root mean square error of the predictions.
+ */
+static double replay(const std::string& path, std::optional<prediction_model_t> model)
+{
+    trace_reader_t reader{path};
+    REQUIRE(reader.is_open());
+
+    std::vector<gesture_event_t> events;
+    gesture_event_t ev;
+    while (reader.next(ev))
+    {
+        events.push_back(ev);
+    }
+
+    gesture_state_t state;
+    if (model)
+    {
+        state.history.set_capacity(16);
+        state.history.set_prediction(*model);
+    }
+
+    const size_t ahead = LATENCY / EVENT_INTERVAL;
+    double sum_sq = 0;
+    int cnt = 0;
+    for (size_t i = 0; i + ahead < events.size() - 1; i++)
+    {
+        state.update(events[i]);
+        const point_t predicted = state.get_predicted_center(events[i].time + LATENCY);
+        const point_t error = predicted - events[i + ahead].pos;
+        sum_sq += error.x * error.x + error.y * error.y;
+        ++cnt;
+    }
+
+    return std::sqrt(sum_sq / cnt);
+}
+
+TEST_CASE("predicted positions follow recorded traces")
+{
+    struct trace_t
+    {
+        const char *name;
+        std::function<point_t(double)> motion;
+        uint32_t duration;
+    };
+
+    const trace_t traces[] = {
+        // a swipe which slows down, at 2 px/ms at first
+        {"swipe", [] (double t) { return point_t{2 * t - t * t / 400, 0.1 * t}; }, 400},
+        // circles with a radius of 100px, one per second
+        {"circle", [] (double t)
+            {
+                const double angle = 2 * M_PI * t / 1000;
+                return point_t{100 * std::cos(angle), 100 * std::sin(angle)};
+            }, 2000},
+        // a zigzag, changing direction four times per second
+        {"zigzag", [] (double t) { return point_t{t, 40 * std::sin(2 * M_PI * t / 500)}; }, 1000},
+    };
+
+    for (auto& trace : traces)
+    {
+        temp_file_t file;
+        record_trace(file.path, trace.motion, trace.duration);
+
+        const double stale = replay(file.path, std::nullopt);
+        const double linear = replay(file.path, PREDICTION_LINEAR);
+        const double kalman = replay(file.path, PREDICTION_KALMAN);
+        MESSAGE(std::string(trace.name) + ": rms error without prediction " +
+            std::to_string(stale) + ", linear " + std::to_string(linear) +
+            ", kalman " + std::to_string(kalman));
+
+        CHECK(linear < stale / 2);
+        CHECK(kalman < stale / 2);
+    }
+}
+
+TEST_CASE("predictions are limited")
+{
+    gesture_state_t state;
+    state.history.set_capacity(8);
+    for (auto model : {PREDICTION_LINEAR, PREDICTION_KALMAN})
+    {
+        state.history.set_prediction(model, 20);
+        state.update({EVENT_TYPE_TOUCH_DOWN, 0, 0, {0, 0}});
+        CHECK(state.get_predicted_position(0, 100) == point_t{0, 0});
+        for (uint32_t t = 10; t <= 100; t += 10)
+        {
+            state.update({EVENT_TYPE_MOTION, t, 0, {t * 1.0, 0}});
+        }
+
+        const point_t at_limit = state.get_predicted_position(0, 120);
+        CHECK(at_limit.x == doctest::Approx(120).epsilon(0.05));
+        CHECK(at_limit.y == doctest::Approx(0));
+        CHECK(state.get_predicted_position(0, 1000) == at_limit);
+        CHECK(state.get_predicted_center(1000) == at_limit);
+
+        // not before the last sample either
+        const point_t now = state.get_predicted_position(0, 100);
+        CHECK(state.get_predicted_position(0, 50) == now);
+
+        state.update({EVENT_TYPE_TOUCH_UP, 100, 0, {100, 0}});
+    }
+
+    // without history, the current positions are used
+    gesture_state_t plain;
+    plain.update({EVENT_TYPE_TOUCH_DOWN, 0, 3, {5, 6}});
+    plain.update({EVENT_TYPE_MOTION, 10, 3, {7, 8}});
+    CHECK(plain.get_predicted_position(3, 100) == point_t{7, 8});
+    CHECK(plain.get_predicted_center(100) == point_t{7, 8});
+    CHECK(plain.get_predicted_position(4, 100) == point_t{0, 0});
+}
@@ -0,0 +1,74 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <wayfire/touch/static-gesture.hpp>
+
+using namespace wf::touch;
+
+TEST_CASE("wf::touch::static_gesture_t")
+{
+    int completed = 0;
+    int cancelled = 0;
+
+    // touch down with two fingers, then swipe left
+    auto swipe = static_gesture_builder_t<>()
+        .action(touch_action_t(2, true).set_duration(100))
+        .action(drag_action_t(MOVE_DIRECTION_LEFT, 50).set_move_tolerance(20).set_duration(200))
+        .on_completed([&] () { ++completed; })
+        .on_cancelled([&] () { ++cancelled; })
+        .build();
+
+    static_assert(decltype(swipe)::size == 2);
+    CHECK(swipe.get_action<0>().get_duration() == 100u);
+
+    swipe.reset(0);
+    CHECK(swipe.get_status() == ACTION_STATUS_RUNNING);
+    swipe.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 0, .finger = 0, .pos = {100, 0}});
+    CHECK(swipe.get_progress() == 0.0);
+    swipe.update_state({.type = EVENT_TYPE_TOUCH_DOWN, .time = 10, .finger = 1, .pos = {100, 10}});
+    CHECK(swipe.get_progress() == doctest::Approx(0.5));
+
+    std::vector<double> progress;
+    swipe.set_update_callback([&] (const gesture_update_t& update)
+    {
+        CHECK(update.action == 1);
+        progress.push_back(update.progress);
+    });
+
+    SUBCASE("complete")
+    {
+        const gesture_event_t events[] = {
+            {.type = EVENT_TYPE_MOTION, .time = 20, .finger = 0, .pos = {40, 0}},
+            {.type = EVENT_TYPE_MOTION, .time = 30, .finger = 1, .pos = {40, 10}},
+            {.type = EVENT_TYPE_MOTION, .time = 40, .finger = 1, .pos = {30, 10}},
+        };
+
+        CHECK(swipe.update_state(events, 3) == 2);
+        CHECK(progress == std::vector<double>{0.6, 1.2});
+        CHECK(swipe.get_status() == ACTION_STATUS_COMPLETED);
+        CHECK(swipe.get_progress() == doctest::Approx(1.0));
+        CHECK(completed == 1);
+        CHECK(cancelled == 0);
+
+        // restart
+        swipe.reset(100);
+        CHECK(swipe.get_status() == ACTION_STATUS_RUNNING);
+        CHECK(swipe.get_progress() == 0.0);
+    }
+
+    SUBCASE("wrong direction")
+    {
+        swipe.update_state({.type = EVENT_TYPE_MOTION, .time = 20, .finger = 0, .pos = {200, 0}});
+        CHECK(swipe.get_status() == ACTION_STATUS_CANCELLED);
+        CHECK(swipe.get_progress() == 0.0);
+        CHECK(cancelled == 1);
+    }
+
+    SUBCASE("timeout")
+    {
+        swipe.advance_time(209);
+        CHECK(swipe.get_status() == ACTION_STATUS_RUNNING);
+        swipe.advance_time(210);
+        CHECK(swipe.get_status() == ACTION_STATUS_CANCELLED);
+        CHECK(cancelled == 1);
+    }
+}
@@ -0,0 +1,177 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <wayfire/touch/timer-wheel.hpp>
+#include <random>
+
+using namespace wf::touch;
+
+/** A host timer driven manually by the test, with a simulated clock. */
+struct fake_host_t
+{
+    uint32_t now = 1000;
+    bool armed = false;
+    uint32_t deadline = 0;
+    int cnt_arms = 0;
+    std::function<void()> handler;
+
+    class timer_t : public timer_interface_t
+    {
+      public:
+        fake_host_t *host;
+        timer_t(fake_host_t *host) : host(host)
+        {}
+
+        void set_timeout(uint32_t msec, std::function<void()> handler) override
+        {
+            host->armed = true;
+            host->deadline = host->now + msec;
+            host->handler = std::move(handler);
+            ++host->cnt_arms;
+        }
+
+        void reset() override
+        {
+            host->armed = false;
+        }
+    };
+
+    /** Fire the host timer until the given time. */
+    void run_until(uint32_t time)
+    {
+        while (armed && ((int32_t)(deadline - time) <= 0))
+        {
+            now = deadline;
+            armed = false;
+            auto h = std::move(handler);
+            h();
+        }
+
+        now = time;
+    }
+};
+
+TEST_CASE("timer_wheel_t")
+{
+    fake_host_t host;
+    timer_wheel_t wheel{std::make_unique<fake_host_t::timer_t>(&host), [&] () { return host.now; }};
+
+    auto a = wheel.create_timer();
+    auto b = wheel.create_timer();
+    auto c = wheel.create_timer();
+    std::vector<std::pair<char, uint32_t>> fired;
+
+    a->set_timeout(100, [&] () { fired.push_back({'a', host.now}); });
+    b->set_timeout(5000, [&] () { fired.push_back({'b', host.now}); });
+    c->set_timeout(30, [&] () { fired.push_back({'c', host.now}); });
+    CHECK(wheel.size() == 3);
+    CHECK(host.armed);
+    CHECK(host.deadline == 1030);
+
+    SUBCASE("expiry order")
+    {
+        host.run_until(10000);
+        CHECK(fired == std::vector<std::pair<char, uint32_t>>{{'c', 1030}, {'a', 1100}, {'b', 6000}});
+        CHECK(wheel.size() == 0);
+        CHECK(!host.armed);
+    }
+
+    SUBCASE("cancel and rearm")
+    {
+        c->reset();
+        CHECK(wheel.size() == 2);
+        host.run_until(1050);
+        CHECK(fired.empty());
+
+        a->set_timeout(10, [&] () { fired.push_back({'a', host.now}); });
+        host.run_until(2000);
+        CHECK(fired == std::vector<std::pair<char, uint32_t>>{{'a', 1060}});
+    }
+
+    SUBCASE("rearm from handler")
+    {
+        int cnt = 0;
+        std::function<void()> tick = [&] ()
+        {
+            if (++cnt < 5)
+            {
+                c->set_timeout(0, tick);
+            }
+        };
+
+        c->set_timeout(0, tick);
+        host.run_until(1000);
+        CHECK(cnt == 1);
+        host.run_until(1010);
+        CHECK(cnt == 5);
+    }
+}
+
+TEST_CASE("timer_wheel_t timers beyond the range of the wheel")
+{
+    fake_host_t host;
+    timer_wheel_t wheel{std::make_unique<fake_host_t::timer_t>(&host), [&] () { return host.now; }};
+
+    // the wheel covers 2^24 ms
+    const uint32_t long_delay = 3 * (1u << 24) + 123;
+    std::vector<uint32_t> fired;
+    auto a = wheel.create_timer();
+    auto b = wheel.create_timer();
+    a->set_timeout(long_delay, [&] () { fired.push_back(host.now); });
+    b->set_timeout(100, [&] () { fired.push_back(host.now); });
+
+    host.run_until(1000 + long_delay - 1);
+    CHECK(fired == std::vector<uint32_t>{1100});
+    CHECK(wheel.size() == 1);
+
+    host.run_until(1000 + long_delay);
+    CHECK(fired == std::vector<uint32_t>{1100, 1000 + long_delay});
+    CHECK(wheel.size() == 0);
+}
+
+TEST_CASE("timer_wheel_t random timers")
+{
+    fake_host_t host;
+    host.now = 0xffff0000u; // check wraparound as well
+    timer_wheel_t wheel{std::make_unique<fake_host_t::timer_t>(&host), [&] () { return host.now; }};
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<uint32_t> delay_dist(0, 200000);
+
+    const int cnt_timers = 500;
+    std::vector<std::unique_ptr<timer_interface_t>> timers;
+    std::vector<uint32_t> expected(cnt_timers), actual(cnt_timers, 0);
+    std::vector<int> cnt_fired(cnt_timers, 0);
+    for (int i = 0; i < cnt_timers; i++)
+    {
+        timers.push_back(wheel.create_timer());
+        expected[i] = host.now + delay_dist(gen);
+        timers[i]->set_timeout(expected[i] - host.now, [&, i] ()
+        {
+            actual[i] = host.now;
+            ++cnt_fired[i];
+        });
+
+        host.run_until(host.now + 7);
+    }
+
+    // cancel every fifth timer which has not fired yet
+    for (int i = 0; i < cnt_timers; i += 5)
+    {
+        if (!cnt_fired[i])
+        {
+            timers[i]->reset();
+            expected[i] = 0;
+        }
+    }
+
+    host.run_until(host.now + 300000);
+    for (int i = 0; i < cnt_timers; i++)
+    {
+        CHECK(cnt_fired[i] == (expected[i] ? 1 : 0));
+        CHECK(actual[i] == expected[i]);
+    }
+
+    // the host was re-armed much less often than there were timers
+    CHECK(host.cnt_arms < 3 * cnt_timers);
+    CHECK(wheel.size() == 0);
+}
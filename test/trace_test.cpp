@@ -0,0 +1,135 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <wayfire/touch/trace.hpp>
+#include <wayfire/touch/gesture-set.hpp>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace wf::touch;
+
+/** A temporary file, removed at the end of the test. */
+struct temp_file_t
+{
+    std::string path;
+    temp_file_t()
+    {
+        char name[] = "/tmp/wf-touch-trace-XXXXXX";
+        int fd = mkstemp(name);
+        REQUIRE(fd >= 0);
+        close(fd);
+        path = name;
+    }
+
+    ~temp_file_t()
+    {
+        unlink(path.c_str());
+    }
+};
+
+TEST_CASE("trace round trip")
+{
+    temp_file_t file;
+    std::vector<gesture_event_t> events = {
+        {EVENT_TYPE_TOUCH_DOWN, 4000000000u, 3, {10.5, 20.25}},
+        {EVENT_TYPE_TOUCH_DOWN, 4000000001u, -7, {-100.125, 0}},
+        {EVENT_TYPE_MOTION, 4000000009u, -7, {-99.75, 1.5}},
+        {EVENT_TYPE_TIMEOUT, 4000000010u, 0, {0, 0}},
+        {EVENT_TYPE_MOTION, 20, 3, {11, 20.25}}, // time wraparound
+        {EVENT_TYPE_TOUCH_UP, 25, 3, {11, 20.25}},
+        {EVENT_TYPE_TOUCH_UP, 25, -7, {1e5, -1e5}},
+    };
+
+    {
+        trace_writer_t writer{file.path};
+        REQUIRE(writer.is_open());
+        for (auto& ev : events)
+        {
+            writer.record(ev);
+        }
+    }
+
+    // the timeout is not recorded
+    events.erase(events.begin() + 3);
+
+    trace_reader_t reader{file.path};
+    REQUIRE(reader.is_open());
+    for (int pass = 0; pass < 2; pass++)
+    {
+        gesture_event_t ev;
+        for (auto& expected : events)
+        {
+            REQUIRE(reader.next(ev));
+            CHECK(ev.type == expected.type);
+            CHECK(ev.time == expected.time);
+            CHECK(ev.finger == expected.finger);
+            CHECK(ev.pos == expected.pos);
+        }
+
+        CHECK(!reader.next(ev));
+        reader.rewind();
+    }
+}
+
+TEST_CASE("trace_reader_t rejects invalid files")
+{
+    temp_file_t file;
+    CHECK(!trace_reader_t{file.path}.is_open());
+    CHECK(!trace_reader_t{file.path + "-missing"}.is_open());
+
+    FILE *f = fopen(file.path.c_str(), "wb");
+    fputs("not a trace file", f);
+    fclose(f);
+    CHECK(!trace_reader_t{file.path}.is_open());
+}
+
+TEST_CASE("replay with timeouts")
+{
+    temp_file_t file;
+    {
+        trace_writer_t writer{file.path};
+        gesture_set_t recorder_set;
+        recorder_set.set_recorder(&writer);
+        recorder_set.update_state({EVENT_TYPE_TOUCH_DOWN, 1000, 0, {0, 0}});
+        recorder_set.update_state({EVENT_TYPE_MOTION, 1050, 0, {1, 0}});
+        recorder_set.update_state({EVENT_TYPE_MOTION, 1150, 0, {2, 0}});
+        recorder_set.update_state({EVENT_TYPE_TOUCH_UP, 1250, 0, {2, 0}});
+    }
+
+    int completed = 0;
+    int cancelled = 0;
+    replay_clock_t clock;
+
+    // touch down, hold for 100ms, then lift within 200ms
+    gesture_t hold = gesture_builder_t()
+        .action(touch_action_t(1, true))
+        .action(hold_action_t(100))
+        .action(touch_action_t(1, false).set_duration(200))
+        .on_completed([&] () { ++completed; })
+        .on_cancelled([&] () { ++cancelled; })
+        .build();
+    hold.set_timer(clock.create_timer());
+
+    for (int run = 1; run <= 2; run++)
+    {
+        trace_reader_t reader{file.path};
+        REQUIRE(reader.is_open());
+        hold.reset(0);
+        replay_trace(reader, clock, [&] (const gesture_event_t& ev)
+        {
+            hold.update_state(ev);
+        });
+
+        CHECK(completed == run);
+        CHECK(cancelled == 0);
+    }
+
+    // lifting too late cancels at the recorded time
+    hold.reset(clock.now());
+    hold.update_state({EVENT_TYPE_TOUCH_DOWN, clock.now(), 0, {0, 0}});
+    clock.advance(clock.now() + 100);
+    CHECK(hold.get_status() == ACTION_STATUS_RUNNING);
+    clock.advance(clock.now() + 199);
+    CHECK(hold.get_status() == ACTION_STATUS_RUNNING);
+    clock.advance(clock.now() + 1);
+    CHECK(cancelled == 1);
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <wayfire/touch/touch.hpp>
+
+namespace wf
+{
+namespace touch
+{
+class trace_writer_t;
+
+/**
+ * A collection of gestures which are recognized from the same events.
+ *
+ * The set keeps a single finger state which is updated once per event.
+ * Until their first action completes, the gestures run their actions on it
+ * directly, so that the finger positions, their sums and the values cached
+ * from them are computed once for all gestures. A gesture which continues
+ * with its next action takes a copy of the state with its own finger
+ * origins, so that origin resets between its actions do not affect the
+ * other gestures, and updates it with the fingers of the shared state.
+ *
+ * Gestures added to the set should be driven only through the set, i.e the
+ * set resets them and passes them the events.
+ */
+class gesture_set_t
+{
+  public:
+    gesture_set_t();
+    ~gesture_set_t();
+
+    gesture_set_t(const gesture_set_t&) = delete;
+    gesture_set_t& operator =(const gesture_set_t&) = delete;
+
+    /**
+     * Add a gesture to the set.
+     *
+     * The gesture's timer should be set before it is added. Gestures without
+     * a timer check their durations against event times, see
+     * gesture_t::set_timer().
+     *
+     * @return A reference to the gesture, valid until the gesture is removed.
+     */
+    gesture_t& add(gesture_t&& gesture);
+
+    /**
+     * Remove a gesture from the set.
+     *
+     * @param gesture A reference returned by add().
+     */
+    void remove(const gesture_t& gesture);
+
+    /**
+     * Put a gesture in a conflict group, where only one gesture may complete
+     * per recognition.
+     *
+     * When a gesture of the group completes, the other running gestures of
+     * the group are cancelled right away and do not see the rest of the
+     * event. If several gestures of the group complete on the same event, the
+     * one with the highest priority wins, or the first one evaluated if the
+     * priorities are equal. Once a gesture of the group has completed during
+     * an event, the gestures which could not win against it are not
+     * evaluated anymore.
+     *
+     * @param gesture A reference returned by add().
+     * @param group The group, or -1 to take the gesture out of its group.
+     * @param priority The priority of the gesture within the group.
+     */
+    void set_conflict_group(gesture_t& gesture, int group, int priority = 0);
+
+    /**
+     * Remove all gestures from the set and release the memory of the gestures
+     * built with get_arena() in bulk.
+     */
+    void clear();
+
+    /**
+     * Get the memory resource for gestures which will be added to this set.
+     * It can be passed to gesture_builder_t, so that the gestures of one
+     * configuration are allocated together and freed by clear().
+     *
+     * Gestures allocated from it must be added to the set, or destroyed
+     * before the set is cleared or destroyed.
+     */
+    std::pmr::memory_resource *get_arena();
+
+    /** @return The number of gestures in the set. */
+    size_t size() const;
+
+    /**
+     * Reset the finger state and restart all gestures.
+     *
+     * @param time The time of the event causing the start of gesture
+     *   recognition, this is typically the first touch event.
+     */
+    void reset(uint32_t time);
+
+    /**
+     * Update the finger state and all running gestures.
+     *
+     * @param event The next event.
+     */
+    void update_state(const gesture_event_t& event);
+
+    /**
+     * Update the finger state and all running gestures with several
+     * consecutive events.
+     *
+     * This is equivalent to calling update_state() for each event. Once no
+     * gesture is running anymore, the remaining events only update the
+     * finger state.
+     *
+     * @param events The events, in the order they happened.
+     * @param count The number of events.
+     */
+    void update_state(const gesture_event_t *events, size_t count);
+
+    /**
+     * Deliver the timeouts of running gestures without a timer, see
+     * gesture_t::advance_time().
+     */
+    void advance_time(uint32_t now);
+
+    /**
+     * Enable or disable coalescing of motion events.
+     *
+     * When enabled, motion events are held back until frame() is called or a
+     * non-motion event arrives, and only the latest motion of each finger is
+     * processed. Disabling coalescing processes the pending motion events.
+     */
+    void set_coalesce_motion(bool enabled);
+
+    /**
+     * Mark the end of an input frame, processing the pending motion events.
+     * Does nothing if motion coalescing is disabled.
+     */
+    void frame();
+
+    /**
+     * Record all events passed to update_state() to a trace.
+     *
+     * @param writer The trace to record to, or nullptr to stop recording.
+     *   It needs to stay alive while recording.
+     */
+    void set_recorder(trace_writer_t *writer);
+
+    /**
+     * @return The finger state shared by the gestures. With motion coalescing,
+     *   it does not include the pending motion events.
+     */
+    const gesture_state_t& get_state() const;
+
+  private:
+    class impl;
+    std::unique_ptr<impl> priv;
+};
+}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <wayfire/touch/touch.hpp>
+
+namespace wf
+{
+namespace touch
+{
+/**
+ * A collection of gestures which evaluates common leading actions once.
+ *
+ * Gestures whose first actions are configured the same way are merged into
+ * a tree, where each node is a single action. The actions on a shared path
+ * are evaluated once per event, and the tree only branches where the
+ * gestures differ. When a node completes, the gestures ending there are
+ * completed and their longer siblings continue; when a node is cancelled,
+ * all gestures through it are cancelled. The callbacks, including the
+ * update callbacks, are the same as if the gestures were run independently.
+ *
+ * Custom actions, i.e not one of the built-in actions, are never merged.
+ *
+ * The timers of the gestures are not used. Durations are checked against the
+ * times of the incoming events instead, see gesture_t::set_timer(), and
+ * advance_time() delivers timeouts when no events arrive.
+ */
+class gesture_trie_t
+{
+  public:
+    gesture_trie_t();
+    ~gesture_trie_t();
+
+    gesture_trie_t(const gesture_trie_t&) = delete;
+    gesture_trie_t& operator =(const gesture_trie_t&) = delete;
+
+    /**
+     * Add a gesture, taking over its actions and callbacks. Gestures added
+     * while recognition is running take part from the next reset().
+     */
+    void add(gesture_t&& gesture);
+
+    /** @return The number of gestures added. */
+    size_t size() const;
+
+    /** @return The number of distinct actions after merging. */
+    size_t count_actions() const;
+
+    /**
+     * Restart the recognition of all gestures.
+     *
+     * Like gesture_t::reset(), this does nothing while gestures are still
+     * running. Since running gestures may share actions with the others,
+     * none of the gestures are restarted in that case.
+     *
+     * @param time The time of the event causing the start of gesture
+     *   recognition, this is typically the first touch event.
+     */
+    void reset(uint32_t time);
+
+    /** @return True if any gesture is still running. */
+    bool is_running() const;
+
+    /**
+     * Update the running gestures.
+     *
+     * @param event The next event.
+     */
+    void update_state(const gesture_event_t& event);
+
+    /** Deliver the timeouts of actions whose durations have passed. */
+    void advance_time(uint32_t now);
+
+  private:
+    class impl;
+    std::unique_ptr<impl> priv;
+};
+}
+}
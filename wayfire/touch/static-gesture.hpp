@@ -0,0 +1,327 @@
+#pragma once
+
+#include <wayfire/touch/touch.hpp>
+#include <tuple>
+#include <algorithm>
+
+namespace wf
+{
+namespace touch
+{
+/**
+ * A gesture whose actions are known at compile time.
+ *
+ * It behaves like gesture_t, but the actions are stored in a tuple and the
+ * current action is called directly, without a virtual call or a lookup in a
+ * vector. Gestures configured at runtime should use gesture_t instead.
+ *
+ * A running gesture with a timer should not be moved, since the timer's
+ * callback refers to the gesture.
+ */
+template<class... Actions>
+class static_gesture_t
+{
+    static_assert(sizeof...(Actions) > 0, "A gesture needs at least one action");
+    static_assert((std::is_base_of_v<gesture_action_t, Actions> && ...),
+        "Actions must be derived from gesture_action_t");
+
+  public:
+    /** The number of actions in the gesture. */
+    static constexpr size_t size = sizeof...(Actions);
+
+    /**
+     * Create a new gesture consisting of the given actions.
+     *
+     * @param actions The actions the gesture consists of.
+     * @param completed The callback to execute each time the gesture is
+     *   completed.
+     * @param cancelled The callback to execute each time the gesture is
+     *   cancelled.
+     */
+    static_gesture_t(std::tuple<Actions...> actions,
+        gesture_callback_t completed = [](){}, gesture_callback_t cancelled = [](){}) :
+        actions(std::move(actions)), completed(std::move(completed)),
+        cancelled(std::move(cancelled))
+    {
+        size_t history_size = std::apply([] (const Actions&... action)
+        {
+            return std::max({size_t(0), action.Actions::get_history_size()...});
+        }, this->actions);
+        finger_state.history.set_capacity(history_size);
+    }
+
+    static_gesture_t(static_gesture_t&& other) = default;
+    static_gesture_t& operator =(static_gesture_t&& other) = default;
+
+    /** @return What percentage of the actions are complete. */
+    double get_progress() const
+    {
+        if (status == ACTION_STATUS_CANCELLED)
+        {
+            return 0.0;
+        }
+
+        return current_action * (1.0 / size);
+    }
+
+    /** @return The current state of the gesture. */
+    action_status_t get_status() const
+    {
+        return status;
+    }
+
+    /** @return The action at the given position in the gesture. */
+    template<size_t I>
+    auto& get_action()
+    {
+        return std::get<I>(actions);
+    }
+
+    /** See gesture_t::set_timer(). */
+    void set_timer(std::unique_ptr<timer_interface_t> timer)
+    {
+        this->timer = std::move(timer);
+    }
+
+    /** See gesture_t::reset(). */
+    void reset(uint32_t time)
+    {
+        if (status == ACTION_STATUS_RUNNING)
+        {
+            return;
+        }
+
+        status = ACTION_STATUS_RUNNING;
+        finger_state.fingers.clear();
+        current_action = 0;
+        using first_action_t = std::tuple_element_t<0, std::tuple<Actions...>>;
+        std::get<0>(actions).first_action_t::reset(time);
+        start_timer(time);
+    }
+
+    /** See gesture_t::set_update_callback(). */
+    void set_update_callback(gesture_update_callback_t callback)
+    {
+        this->updated = std::move(callback);
+    }
+
+    /** See gesture_t::update_state(). */
+    void update_state(const gesture_event_t& event)
+    {
+        if (event.type != EVENT_TYPE_TIMEOUT)
+        {
+            advance_time(event.time);
+        }
+
+        if (status != ACTION_STATUS_RUNNING)
+        {
+            return;
+        }
+
+        finger_state.update(event);
+        handle_event(event);
+    }
+
+    /** See gesture_t::update_state(). */
+    size_t update_state(const gesture_event_t *events, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (status != ACTION_STATUS_RUNNING)
+            {
+                return i;
+            }
+
+            update_state(events[i]);
+        }
+
+        return count;
+    }
+
+    /** See gesture_t::advance_time(). */
+    void advance_time(uint32_t now)
+    {
+        while ((status == ACTION_STATUS_RUNNING) && deadline &&
+               ((int32_t)(now - *deadline) >= 0))
+        {
+            const uint32_t expired = *deadline;
+            deadline.reset();
+            handle_event(gesture_event_t{.type = EVENT_TYPE_TIMEOUT, .time = expired});
+        }
+    }
+
+  private:
+    std::tuple<Actions...> actions;
+    gesture_callback_t completed;
+    gesture_callback_t cancelled;
+    gesture_update_callback_t updated;
+
+    size_t current_action = 0;
+    action_status_t status = ACTION_STATUS_CANCELLED;
+    gesture_state_t finger_state;
+    std::unique_ptr<timer_interface_t> timer;
+    std::optional<uint32_t> deadline;
+
+    /**
+     * Call func with the current action. The calls for each action are
+     * generated at compile time, so that func sees the concrete action type.
+     */
+    template<class Func, size_t... I>
+    auto with_current_action(Func&& func, std::index_sequence<I...>)
+    {
+        using result_t = decltype(func(std::get<0>(actions)));
+        if constexpr (std::is_void_v<result_t>)
+        {
+            ((current_action == I ? (func(std::get<I>(actions)), true) : false) || ...);
+        } else
+        {
+            result_t result{};
+            ((current_action == I ? (result = func(std::get<I>(actions)), true) : false) || ...);
+            return result;
+        }
+    }
+
+    template<class Func>
+    auto with_current_action(Func&& func)
+    {
+        return with_current_action(std::forward<Func>(func),
+            std::index_sequence_for<Actions...>{});
+    }
+
+    void start_timer(uint32_t time)
+    {
+        deadline.reset();
+        auto dur = with_current_action([] (auto& action)
+        {
+            return action.get_duration();
+        });
+
+        if (dur)
+        {
+            if (!timer)
+            {
+                deadline = time + *dur;
+                return;
+            }
+
+            timer->set_timeout(*dur, [=] ()
+            {
+                update_state(gesture_event_t{.type = EVENT_TYPE_TIMEOUT});
+            });
+        }
+    }
+
+    void stop_timer()
+    {
+        deadline.reset();
+        if (timer)
+        {
+            timer->reset();
+        }
+    }
+
+    void handle_event(const gesture_event_t& event)
+    {
+        action_status_t pending_status = with_current_action([&] (auto& action)
+        {
+            using action_type = std::decay_t<decltype(action)>;
+            auto status = action.action_type::update_state(finger_state, event);
+            if ((status == ACTION_STATUS_RUNNING) &&
+                action.action_type::will_never_complete(finger_state))
+            {
+                return ACTION_STATUS_CANCELLED;
+            }
+
+            return status;
+        });
+
+        if (updated && (pending_status != ACTION_STATUS_CANCELLED))
+        {
+            const double progress = with_current_action([] (auto& action)
+            {
+                return action.get_progress();
+            });
+            updated({current_action, progress, finger_state});
+        }
+
+        switch (pending_status)
+        {
+          case ACTION_STATUS_RUNNING:
+            return;
+
+          case ACTION_STATUS_CANCELLED:
+            status = ACTION_STATUS_CANCELLED;
+            stop_timer();
+            cancelled();
+            return;
+
+          case ACTION_STATUS_COMPLETED:
+            stop_timer();
+            if (++current_action < size)
+            {
+                with_current_action([&] (auto& action)
+                {
+                    using action_type = std::decay_t<decltype(action)>;
+                    action.action_type::reset(event.time);
+                });
+                finger_state.reset_origin();
+                start_timer(event.time);
+                return;
+            }
+
+            status = ACTION_STATUS_COMPLETED;
+            completed();
+            return;
+        }
+    }
+};
+
+/**
+ * A helper class to construct a static_gesture_t with the same syntax as
+ * gesture_builder_t. Each added action yields a builder of a new type, so
+ * the actions should be added before the callbacks.
+ */
+template<class... Actions>
+class static_gesture_builder_t
+{
+  public:
+    static_gesture_builder_t() = default;
+
+    static_gesture_builder_t(std::tuple<Actions...> actions,
+        gesture_callback_t completed, gesture_callback_t cancelled) :
+        actions(std::move(actions)), _on_completed(std::move(completed)),
+        _on_cancelled(std::move(cancelled))
+    {}
+
+    template<class ActionType>
+    static_gesture_builder_t<Actions..., std::decay_t<ActionType>> action(ActionType&& action)
+    {
+        return {std::tuple_cat(std::move(actions),
+            std::make_tuple(std::forward<ActionType>(action))),
+            std::move(_on_completed), std::move(_on_cancelled)};
+    }
+
+    static_gesture_builder_t& on_completed(gesture_callback_t callback)
+    {
+        _on_completed = std::move(callback);
+        return *this;
+    }
+
+    static_gesture_builder_t& on_cancelled(gesture_callback_t callback)
+    {
+        _on_cancelled = std::move(callback);
+        return *this;
+    }
+
+    static_gesture_t<Actions...> build()
+    {
+        return {std::move(actions), std::move(_on_completed), std::move(_on_cancelled)};
+    }
+
+  private:
+    std::tuple<Actions...> actions;
+    gesture_callback_t _on_completed = [](){};
+    gesture_callback_t _on_cancelled = [](){};
+};
+}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <wayfire/touch/touch.hpp>
+
+namespace wf
+{
+namespace touch
+{
+/**
+ * A hierarchical timer wheel which multiplexes many timers onto a single
+ * host timer, with millisecond resolution.
+ *
+ * Arming and cancelling a timer is O(1) and does not allocate, as long as
+ * the handler fits into std::function's small buffer (as the handlers of
+ * gesture_t do). The host timer is only re-armed when the earliest expiry
+ * moves closer.
+ *
+ * Timers of more than about four hours are kept at the end of the range of
+ * the wheel and linked again from there, so they still expire on time.
+ *
+ * The wheel needs to outlive the timers created by it.
+ */
+class timer_wheel_t
+{
+  public:
+    /**
+     * Create a new timer wheel.
+     *
+     * @param host The timer used to wake up the wheel.
+     * @param clock A function returning the current time in milliseconds.
+     */
+    timer_wheel_t(std::unique_ptr<timer_interface_t> host,
+        std::function<uint32_t()> clock);
+    ~timer_wheel_t();
+
+    timer_wheel_t(const timer_wheel_t&) = delete;
+    timer_wheel_t& operator =(const timer_wheel_t&) = delete;
+
+    /** Create a new timer driven by the wheel, e.g for gesture_t::set_timer(). */
+    std::unique_ptr<timer_interface_t> create_timer();
+
+    /**
+     * Run the handlers of all timers which expire until the given time.
+     * This is called automatically when the host timer fires.
+     */
+    void advance(uint32_t now);
+
+    /** @return The number of armed timers. */
+    size_t size() const;
+
+  private:
+    class impl;
+    class timer_t;
+    std::unique_ptr<impl> priv;
+};
+}
+}
@@ -16,10 +16,18 @@
  */
 #include <glm/vec2.hpp>
 #include <vector>
-#include <map>
+#include <array>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+#include <cstddef>
 #include <memory>
 #include <functional>
 #include <optional>
+#include <memory_resource>
+#include <variant>
+#include <type_traits>
 
 namespace wf
 {
@@ -85,6 +93,317 @@ struct gesture_event_t
     point_t pos{};
 };
 
+/**
+ * A fixed-capacity map from finger id to finger_t.
+ *
+ * The fingers are stored contiguously and sorted by their id, so iteration
+ * order is the same as with std::map<int, finger_t>. Inserting and erasing
+ * fingers never allocates, and looking up a finger is a linear scan over at
+ * most MAX_FINGERS entries.
+ *
+ * The map also keeps a version number which changes whenever the fingers
+ * are modified, so that values derived from the fingers can be cached.
+ * Inserting, erasing and operator[] change it. Fingers modified through an
+ * iterator need to be reported with mark_modified().
+ */
+class finger_map_t
+{
+  public:
+    /** The maximal number of fingers which can be tracked at the same time. */
+    static constexpr size_t MAX_FINGERS = 20;
+
+    using value_type     = std::pair<int, finger_t>;
+    using iterator       = value_type*;
+    using const_iterator = const value_type*;
+
+    finger_map_t() = default;
+    finger_map_t(const finger_map_t& other) = default;
+    finger_map_t& operator =(const finger_map_t& other)
+    {
+        uint64_t next_version = std::max(this->current_version, other.current_version) + 1;
+        this->slots = other.slots;
+        this->used = other.used;
+        this->current_version = next_version;
+        return *this;
+    }
+
+    iterator begin()
+    {
+        return slots.data();
+    }
+
+    iterator end()
+    {
+        return slots.data() + used;
+    }
+
+    const_iterator begin() const
+    {
+        return slots.data();
+    }
+
+    const_iterator end() const
+    {
+        return slots.data() + used;
+    }
+
+    size_t size() const
+    {
+        return used;
+    }
+
+    bool empty() const
+    {
+        return used == 0;
+    }
+
+    bool full() const
+    {
+        return used == MAX_FINGERS;
+    }
+
+    void clear()
+    {
+        ++current_version;
+        used = 0;
+    }
+
+    /** @return The finger with the given id, or end() if there is none. */
+    iterator find(int id)
+    {
+        return slots.data() + lookup(id);
+    }
+
+    const_iterator find(int id) const
+    {
+        return slots.data() + lookup(id);
+    }
+
+    size_t count(int id) const
+    {
+        return lookup(id) < used ? 1 : 0;
+    }
+
+    /**
+     * Get the finger with the given id for modification, inserting a
+     * default-constructed one if it does not exist yet.
+     *
+     * Inserting into a full map is a programming error. Without assertions,
+     * a scratch finger which is not part of the map is returned instead.
+     */
+    finger_t& operator [](int id);
+
+    /** Report that fingers were modified through an iterator. */
+    void mark_modified()
+    {
+        ++current_version;
+    }
+
+    /**
+     * Remove the finger with the given id.
+     *
+     * @return The number of removed fingers (0 or 1).
+     */
+    size_t erase(int id);
+
+    /** @return A number which changes whenever the fingers may have changed. */
+    uint64_t version() const
+    {
+        return current_version;
+    }
+
+  private:
+    size_t lookup(int id) const
+    {
+        for (size_t i = 0; i < used; i++)
+        {
+            if (slots[i].first == id)
+            {
+                return i;
+            }
+        }
+
+        return used;
+    }
+
+    std::array<value_type, MAX_FINGERS> slots;
+
+    // Returned by operator[] when inserting into a full map.
+    finger_t overflow;
+    size_t used = 0;
+    uint64_t current_version = 0;
+};
+
+/**
+ * How finger_history_t extrapolates the positions of the fingers.
+ */
+enum prediction_model_t
+{
+    /** Extend the line fitted to the most recent samples. */
+    PREDICTION_LINEAR,
+    /** Extend the estimate of a constant velocity Kalman filter. */
+    PREDICTION_KALMAN,
+};
+
+/**
+ * The recent positions of the fingers with their timestamps, kept in a ring
+ * buffer of fixed size per finger.
+ *
+ * The history is disabled by default. Once enabled, the buffers are allocated
+ * at the first touch down and reused afterwards, also when copying into a
+ * history of the same capacity. The samples of a lifted finger are kept
+ * until the finger touches down again or its buffer is needed for another
+ * finger, so that its velocity can still be queried after the touch up.
+ */
+class finger_history_t
+{
+  public:
+    /** The largest number of samples which can be kept per finger. */
+    static constexpr size_t MAX_SAMPLES = 64;
+
+    /** The default time window of the estimators, in milliseconds. */
+    static constexpr uint32_t DEFAULT_WINDOW = 100;
+
+    finger_history_t() = default;
+    finger_history_t(const finger_history_t& other);
+
+    /**
+     * Copy the samples of another history. The capacity of this history is
+     * kept, so only the latest samples of each finger which fit are copied,
+     * and copying does not allocate once this history has recorded samples.
+     */
+    finger_history_t& operator =(const finger_history_t& other);
+
+    /**
+     * Set the number of samples kept per finger. This drops all samples.
+     *
+     * @param samples The number of samples, at most MAX_SAMPLES, or 0 to
+     *   disable the history.
+     */
+    void set_capacity(size_t samples);
+
+    /** @return The number of samples kept per finger. */
+    size_t get_capacity() const;
+
+    /**
+     * Record the position of a finger. A touch down starts a new series of
+     * samples for the finger. Does nothing if the history is disabled.
+     */
+    void record(const gesture_event_t& event);
+
+    /** @return The number of samples of the finger. */
+    size_t count_samples(int finger) const;
+
+    /**
+     * Estimate the velocity of a finger at its last sample, by fitting a line
+     * to its samples in the time window before the last sample.
+     *
+     * @param finger The id of the finger.
+     * @param window The length of the time window in milliseconds.
+     * @return The velocity in units per millisecond, or {0, 0} if the finger
+     *   has less than two samples in the window.
+     */
+    point_t get_velocity(int finger, uint32_t window = DEFAULT_WINDOW) const;
+
+    /**
+     * Estimate the acceleration of a finger at its last sample, by fitting a
+     * parabola to its samples in the time window before the last sample.
+     *
+     * @return The acceleration in units per squared millisecond, or {0, 0}
+     *   if the finger has less than three samples in the window.
+     */
+    point_t get_acceleration(int finger, uint32_t window = DEFAULT_WINDOW) const;
+
+    /** The default of the longest time positions are extrapolated for. */
+    static constexpr uint32_t DEFAULT_PREDICTION_LIMIT = 50;
+
+    /**
+     * Choose how positions are predicted, see predict().
+     *
+     * @param model The prediction model.
+     * @param limit The longest time in milliseconds past the last sample of
+     *   a finger to extrapolate for. Predictions further in the future stop
+     *   there, so that a stale velocity does not carry the finger away.
+     */
+    void set_prediction(prediction_model_t model,
+        uint32_t limit = DEFAULT_PREDICTION_LIMIT);
+
+    /**
+     * Predict where a finger is at the given time, for example when the next
+     * frame is shown. The cost does not depend on the time, and is constant
+     * for the Kalman filter, whose state is updated by record().
+     *
+     * @param finger The id of the finger.
+     * @param time The time of the prediction in milliseconds.
+     * @return The predicted position, or nothing if the finger has no samples.
+     */
+    std::optional<point_t> predict(int finger, uint32_t time) const;
+
+  private:
+    struct sample_t
+    {
+        uint32_t time;
+        point_t pos;
+    };
+
+    /** The samples of one finger, in a ring buffer. */
+    struct track_t
+    {
+        int finger;
+        bool down = false;
+        bool used = false;
+        size_t first = 0;
+        size_t count = 0;
+
+        /**
+         * The position and velocity estimated by the Kalman filter. The
+         * covariance is the same for both axes: [pos, pos-vel, vel].
+         */
+        point_t filter_pos;
+        point_t filter_vel;
+        double filter_cov[3];
+    };
+
+    /** Run the Kalman filter of a track on a new sample. */
+    void update_filter(track_t& track, uint32_t dt, point_t pos);
+
+    /** @return The track of the finger, or nullptr. */
+    const track_t *find(int finger) const;
+
+    /**
+     * Fit a polynomial of the given degree to the samples of a finger in the
+     * window, with the time relative to the last sample.
+     *
+     * @return False if there are not enough samples.
+     */
+    bool fit(int finger, uint32_t window, int degree, point_t coefficients[3]) const;
+
+    size_t capacity = 0;
+    prediction_model_t model = PREDICTION_LINEAR;
+    uint32_t prediction_limit = DEFAULT_PREDICTION_LIMIT;
+    std::unique_ptr<track_t[]> tracks;
+    std::unique_ptr<sample_t[]> samples;
+};
+
+/**
+ * The fingers of a gesture state in structure-of-arrays layout, in the order
+ * of the finger map, so that the math over all fingers can process several
+ * fingers with a single instruction.
+ *
+ * The arrays are aligned and sized for the widest vectors. Only the first
+ * count entries are valid.
+ */
+struct finger_soa_t
+{
+    static constexpr size_t CAPACITY = (finger_map_t::MAX_FINGERS + 3) / 4 * 4;
+
+    alignas(32) double origin_x[CAPACITY];
+    alignas(32) double origin_y[CAPACITY];
+    alignas(32) double current_x[CAPACITY];
+    alignas(32) double current_y[CAPACITY];
+    size_t count = 0;
+};
+
 /**
  * Contains all fingers.
  */
@@ -92,25 +411,251 @@ struct gesture_state_t
 {
   public:
     // finger_id -> finger_t
-    std::map<int, finger_t> fingers;
+    finger_map_t fingers;
 
-    /** Update fingers based on the event */
+    /**
+     * The recent positions of the fingers, recorded by update() if enabled.
+     * Gestures enable it on their state if one of their actions needs it,
+     * see gesture_action_t::get_history_size().
+     */
+    finger_history_t history;
+
+    /**
+     * Update fingers based on the event.
+     *
+     * Touch down events for new fingers are ignored if there are already
+     * finger_map_t::MAX_FINGERS fingers on the screen.
+     */
     void update(const gesture_event_t& event);
 
     /** Reset finger origin to current positions */
     void reset_origin();
 
-    /** Find the center points of the fingers. */
+    /**
+     * Find the center points of the fingers.
+     *
+     * The sums of the finger positions are kept up to date by update() and
+     * reset_origin(), so this is O(1) unless the fingers were modified
+     * directly since the last call.
+     */
     finger_t get_center() const;
 
     /** Get the pinch scale of current touch points. */
     double get_pinch_scale() const;
 
     /**
-     * Get the rotation angle in radians of current touch points.
-     * NB: Works only for rotation < 180 degrees.
+     * Get the rotation angle in radians of current touch points, counted from
+     * the last reset_origin(), or from when there were no fingers.
+     *
+     * The rotation is tracked by update(), which computes the angle that best
+     * rotates the origins onto the current positions around their centers
+     * with a single atan2, and unwraps it across half turns. This makes the
+     * query O(1), and the angle is not limited to one turn. If the fingers
+     * were modified directly, the same angle is computed from the origins of
+     * the fingers instead, which works only for rotation < 180 degrees.
      */
     double get_rotation_angle() const;
+
+    /** Get the largest distance a finger has moved from its origin. */
+    double get_max_delta() const;
+
+    /**
+     * Get the fingers in structure-of-arrays layout. They are kept up to date
+     * by update() and reset_origin(), and only copied from the finger map if
+     * the fingers were modified directly.
+     */
+    const finger_soa_t& get_finger_arrays() const;
+
+    /**
+     * Estimate the velocity of the center of the fingers on the screen, as
+     * the mean velocity of the fingers, see finger_history_t::get_velocity().
+     *
+     * @return The velocity in units per millisecond, or {0, 0} without
+     *   fingers or history.
+     */
+    point_t get_center_velocity(uint32_t window = finger_history_t::DEFAULT_WINDOW) const;
+
+    /**
+     * Predict the position of a finger at the given time, see
+     * finger_history_t::predict().
+     *
+     * @return The predicted position, or the current position of the finger
+     *   if the history is disabled, or {0, 0} for an unknown finger.
+     */
+    point_t get_predicted_position(int finger, uint32_t time) const;
+
+    /**
+     * Predict the position of the center of the fingers at the given time,
+     * as the mean of the predicted positions of the fingers.
+     *
+     * @return The predicted center, or {0, 0} without fingers.
+     */
+    point_t get_predicted_center(uint32_t time) const;
+
+    /*
+     * NB: The pinch scale, rotation angle and maximal delta are computed at
+     * most once for each version of the fingers, and then cached. This makes
+     * it unsafe to query the same state from multiple threads at once.
+     */
+
+  private:
+    enum cached_value_t
+    {
+        CACHED_PINCH_SCALE    = (1 << 0),
+        CACHED_ROTATION_ANGLE = (1 << 1),
+        CACHED_MAX_DELTA      = (1 << 2),
+    };
+
+    /** @return True if the given value is cached for the current fingers. */
+    bool is_cached(cached_value_t value) const;
+
+    mutable uint64_t cache_version = UINT64_MAX;
+    mutable uint32_t cached_values = 0;
+    mutable double cached_pinch_scale;
+    mutable double cached_rotation_angle;
+    mutable double cached_max_delta;
+
+    /** Recompute the position sums from scratch. */
+    void resync_sums() const;
+
+    /**
+     * Number of incremental updates after which the sums are recomputed, so
+     * that rounding errors do not accumulate over long gestures.
+     */
+    static constexpr uint32_t SUMS_RESYNC_INTERVAL = 256;
+
+    // Sums of the origin and current positions of all fingers, valid if
+    // sums_version matches the version of the fingers.
+    mutable point_t origin_sum = {0, 0};
+    mutable point_t current_sum = {0, 0};
+    // Sums of the cross and dot products of the origin and current position
+    // of each finger, from which the rotation is computed.
+    mutable double cross_sum = 0;
+    mutable double dot_sum = 0;
+    mutable uint64_t sums_version = 0;
+    mutable uint32_t sums_updates = 0;
+
+    /**
+     * Update the rotation from the sums, keeping it continuous across half
+     * turns. The sums need to be valid.
+     */
+    void track_rotation();
+
+    // Rotation since the origins were reset, valid if rotation_version
+    // matches the version of the fingers.
+    double rotation = 0;
+    uint64_t rotation_version = 0;
+
+    /** Copy the fingers into the arrays from scratch. */
+    void resync_arrays() const;
+
+    // The fingers in structure-of-arrays layout, valid if arrays_version
+    // matches the version of the fingers.
+    mutable finger_soa_t arrays;
+    mutable uint64_t arrays_version = UINT64_MAX;
+};
+
+/**
+ * The instruction sets which can be used for the math over all fingers, like
+ * gesture_state_t::get_pinch_scale() and the move tolerance checks.
+ */
+enum simd_level_t
+{
+    /** One finger at a time. */
+    SIMD_LEVEL_SCALAR,
+    /** Two fingers at a time, on x86 CPUs. */
+    SIMD_LEVEL_SSE2,
+    /** Four fingers at a time, on x86 CPUs with AVX2. */
+    SIMD_LEVEL_AVX2,
+};
+
+/** @return The best instruction set supported by the CPU. */
+simd_level_t get_supported_simd_level();
+
+/** @return The instruction set used for the finger math. */
+simd_level_t get_simd_level();
+
+/**
+ * Select the instruction set for the finger math. By default, the best one
+ * supported by the CPU is used, and levels the CPU does not support are
+ * lowered to the best supported one.
+ *
+ * The results of the levels may differ in the last bits, because the sums
+ * over the fingers are added in a different order. This should not be called
+ * while gestures are processed on other threads.
+ */
+void set_simd_level(simd_level_t level);
+
+/**
+ * Collapses consecutive motion events of the same finger.
+ *
+ * Between touch down and up events only the latest position of each finger
+ * matters, so motion events can be held back until the end of an input frame
+ * and then processed once per finger.
+ */
+class motion_coalescer_t
+{
+  public:
+    /**
+     * Try to hold back an event.
+     *
+     * Motion events are stored, replacing an earlier motion of the same
+     * finger. Other events are not stored; the caller needs to flush() the
+     * pending motions before processing them, to keep the order of events.
+     *
+     * @return True if the event was stored, false otherwise.
+     */
+    bool push(const gesture_event_t& event)
+    {
+        if (event.type != EVENT_TYPE_MOTION)
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < cnt_pending; i++)
+        {
+            if (pending[i].finger == event.finger)
+            {
+                pending[i] = event;
+                return true;
+            }
+        }
+
+        if (cnt_pending == pending.size())
+        {
+            return false;
+        }
+
+        pending[cnt_pending++] = event;
+        return true;
+    }
+
+    /**
+     * Pass all pending motion events to the handler, in the order their
+     * fingers first moved, and forget them.
+     *
+     * The handler must not push new events.
+     */
+    template<class Handler>
+    void flush(Handler&& handler)
+    {
+        for (size_t i = 0; i < cnt_pending; i++)
+        {
+            handler(pending[i]);
+        }
+
+        cnt_pending = 0;
+    }
+
+    /** @return The number of pending motion events. */
+    size_t size() const
+    {
+        return cnt_pending;
+    }
+
+  private:
+    std::array<gesture_event_t, finger_map_t::MAX_FINGERS> pending;
+    size_t cnt_pending = 0;
 };
 
 /**
@@ -166,13 +711,49 @@ class gesture_action_t
      */
     virtual void reset(uint32_t time);
 
+    /**
+     * A cheap hint that the action cannot complete anymore, whatever events
+     * follow. It is checked after each event for which update_state() returns
+     * running, and the gesture is cancelled right away if it returns true.
+     *
+     * @param state The gesture state after the last event.
+     */
+    virtual bool will_never_complete(const gesture_state_t&) const
+    {
+        return false;
+    }
+
+    /**
+     * @return The number of samples per finger which the action needs in the
+     *   finger history of its gesture's state, see gesture_state_t::history.
+     */
+    virtual size_t get_history_size() const
+    {
+        return 0;
+    }
+
+    /**
+     * Get how far the action has come towards completion, as measured by the
+     * last call to update_state(). For example, a drag action reports the
+     * distance dragged divided by its threshold.
+     *
+     * @return The progress, 0 right after reset() and 1 when the threshold
+     *   is reached. It may be negative, for example when pinching in for a
+     *   pinch out action. Actions which do not measure their progress
+     *   always report 0.
+     */
+    double get_progress() const;
+
     virtual ~gesture_action_t() {}
 
   protected:
     gesture_action_t() {}
 
     /** Time of the first event. */
-    int64_t start_time;
+    int64_t start_time = 0;
+
+    /** See get_progress(), to be updated by update_state(). */
+    double progress = 0.0;
 
   private:
     std::optional<uint32_t> duration; // maximal duration
@@ -219,6 +800,9 @@ class touch_action_t : public gesture_action_t
     touch_action_t(int cnt_fingers, bool touch_down);
     WFTOUCH_BUILDER_REPEAT_MEMBERS_WITH_CAST(touch_action_t);
 
+    /** @return True if both actions are configured the same way. */
+    bool operator ==(const touch_action_t& other) const;
+
     /**
      * Set the target area of this gesture.
      *
@@ -226,6 +810,15 @@ class touch_action_t : public gesture_action_t
      */
     touch_action_t& set_target(const touch_target_t& target);
 
+    /** @return The number of fingers the action waits for. */
+    int get_finger_count() const;
+
+    /** @return EVENT_TYPE_TOUCH_DOWN or EVENT_TYPE_TOUCH_UP. */
+    gesture_event_type_t get_type() const;
+
+    /** @return The target area of the action. */
+    const touch_target_t& get_target() const;
+
     /**
      * Mark the action as completed iff state has the right amount of fingers
      * and if the event is a touch down.
@@ -233,11 +826,18 @@ class touch_action_t : public gesture_action_t
     action_status_t update_state(const gesture_state_t& state,
         const gesture_event_t& event) override;
 
+    /**
+     * A touch down action never completes once the fingers moved too much, or
+     * a finger which was down before the action started is outside of the
+     * target, since the next touch down checks all fingers.
+     */
+    bool will_never_complete(const gesture_state_t& state) const override;
+
     void reset(uint32_t time) override;
 
   protected:
     /** @return True if the fingers have moved too much. */
-    bool exceeds_tolerance(const gesture_state_t& state);
+    bool exceeds_tolerance(const gesture_state_t& state) const;
 
   private:
     int cnt_fingers;
@@ -264,6 +864,9 @@ class hold_action_t : public gesture_action_t
     hold_action_t(int32_t threshold);
     WFTOUCH_BUILDER_REPEAT_MEMBERS_WITH_CAST(hold_action_t);
 
+    /** @return True if both actions are configured the same way. */
+    bool operator ==(const hold_action_t& other) const;
+
     /**
      * The action is already completed iff no fingers have been added or
      * released and the given amount of time has passed without much movement.
@@ -271,9 +874,12 @@ class hold_action_t : public gesture_action_t
     action_status_t update_state(const gesture_state_t& state,
         const gesture_event_t& event) override;
 
+    /** The action never completes once the fingers moved too much. */
+    bool will_never_complete(const gesture_state_t& state) const override;
+
   protected:
     /** @return True if the fingers have moved too much. */
-    bool exceeds_tolerance(const gesture_state_t& state);
+    bool exceeds_tolerance(const gesture_state_t& state) const;
 
   private:
     uint32_t move_tolerance = 1e9;
@@ -295,6 +901,9 @@ class drag_action_t : public gesture_action_t
     drag_action_t(uint32_t direction, double threshold);
     WFTOUCH_BUILDER_REPEAT_MEMBERS_WITH_CAST(drag_action_t);
 
+    /** @return True if both actions are configured the same way. */
+    bool operator ==(const drag_action_t& other) const;
+
     /**
      * The action is already completed iff no fingers have been added or
      * released and the given amount of time has passed without much movement.
@@ -302,17 +911,62 @@ class drag_action_t : public gesture_action_t
     action_status_t update_state(const gesture_state_t& state,
         const gesture_event_t& event) override;
 
+    /**
+     * The action never completes once a finger moved more than the tolerance
+     * in an incorrect direction.
+     */
+    bool will_never_complete(const gesture_state_t& state) const override;
+
   protected:
     /**
      * @return True if any finger has moved more than the threshold in an
      *  incorrect direction.
      */
-    bool exceeds_tolerance(const gesture_state_t& state);
+    bool exceeds_tolerance(const gesture_state_t& state) const;
+
+    /**
+     * Check the tolerance as part of update_state(), remembering the fingers
+     * which were within it, so will_never_complete() does not check them again.
+     */
+    bool exceeds_tolerance_on_update(const gesture_state_t& state);
 
-  private:
     double threshold;
     uint32_t direction;
     uint32_t move_tolerance = 1e9;
+
+  private:
+    uint64_t tolerance_checked = UINT64_MAX;
+};
+
+/**
+ * A drag which completes once the fingers move fast enough in its direction,
+ * however short the distance they moved.
+ *
+ * The speed is estimated from the finger history, which gestures with this
+ * action enable on their state.
+ */
+class flick_action_t : public drag_action_t
+{
+  public:
+    /** The number of samples per finger used to estimate the speed. */
+    static constexpr size_t HISTORY_SIZE = 16;
+
+    /**
+     * Create a new flick action.
+     *
+     * @param direction The direction of the flick.
+     * @param speed The speed the center of the fingers needs to reach in the
+     *   direction, in units per millisecond.
+     */
+    flick_action_t(uint32_t direction, double speed);
+    WFTOUCH_BUILDER_REPEAT_MEMBERS_WITH_CAST(flick_action_t);
+
+    action_status_t update_state(const gesture_state_t& state,
+        const gesture_event_t& event) override;
+    size_t get_history_size() const override;
+
+  private:
+    double speed;
 };
 
 /**
@@ -331,6 +985,9 @@ class pinch_action_t : public gesture_action_t
     pinch_action_t(double threshold);
     WFTOUCH_BUILDER_REPEAT_MEMBERS_WITH_CAST(pinch_action_t);
 
+    /** @return True if both actions are configured the same way. */
+    bool operator ==(const pinch_action_t& other) const;
+
     /**
      * The action is already completed iff no fingers have been added or
      * released and the pinch threshold has been reached without much movement.
@@ -338,11 +995,14 @@ class pinch_action_t : public gesture_action_t
     action_status_t update_state(const gesture_state_t& state,
         const gesture_event_t& event) override;
 
+    /** The action never completes once the center moved too much. */
+    bool will_never_complete(const gesture_state_t& state) const override;
+
   protected:
     /**
      * @return True if gesture center has moved more than tolerance.
      */
-    bool exceeds_tolerance(const gesture_state_t& state);
+    bool exceeds_tolerance(const gesture_state_t& state) const;
 
   private:
     double threshold;
@@ -361,10 +1021,15 @@ class rotate_action_t : public gesture_action_t
      * @param threshold The threshold to be exceeded.
      *   If threshold is less/more than 0, then the action is complete when
      *   the actual rotation angle is respectively less/more than threshold.
+     *   It may be more than a full turn, see
+     *   gesture_state_t::get_rotation_angle().
      */
     rotate_action_t(double threshold);
     WFTOUCH_BUILDER_REPEAT_MEMBERS_WITH_CAST(rotate_action_t);
 
+    /** @return True if both actions are configured the same way. */
+    bool operator ==(const rotate_action_t& other) const;
+
     /**
      * The action is already completed iff no fingers have been added or
      * released and the rotation threshold has been reached without much movement.
@@ -372,19 +1037,227 @@ class rotate_action_t : public gesture_action_t
     action_status_t update_state(const gesture_state_t& state,
         const gesture_event_t& event) override;
 
+    /** The action never completes once the center moved too much. */
+    bool will_never_complete(const gesture_state_t& state) const override;
+
   protected:
     /**
      * @return True if gesture center has moved more than tolerance.
      */
-    bool exceeds_tolerance(const gesture_state_t& state);
+    bool exceeds_tolerance(const gesture_state_t& state) const;
 
   private:
     double threshold;
     uint32_t move_tolerance = 1e9;
 };
 
+/**
+ * Storage for the actions of a gesture.
+ *
+ * The built-in actions are stored inline, so that the actions of a gesture
+ * are contiguous in memory and can be called without virtual dispatch.
+ * Other actions are stored through a pointer.
+ */
+using action_storage_t = std::variant<touch_action_t, hold_action_t, drag_action_t,
+    pinch_action_t, rotate_action_t, std::unique_ptr<gesture_action_t>>;
+
+/** Whether an action type can be stored inline in action_storage_t. */
+template<class ActionType>
+constexpr bool is_inline_action_v =
+    std::is_same_v<ActionType, touch_action_t> ||
+    std::is_same_v<ActionType, hold_action_t> ||
+    std::is_same_v<ActionType, drag_action_t> ||
+    std::is_same_v<ActionType, pinch_action_t> ||
+    std::is_same_v<ActionType, rotate_action_t>;
+
+/** @return The action kept in the storage. */
+gesture_action_t& get_action(action_storage_t& storage);
+const gesture_action_t& get_action(const action_storage_t& storage);
+
+/* Groups are move-only, so chained calls on a temporary yield a temporary. */
+#define WFTOUCH_GROUP_MEMBERS_WITH_CAST(x) \
+    template<class ActionType> \
+    x& action(ActionType&& action) & \
+    { \
+        add_child(std::forward<ActionType>(action)); \
+        return *this; \
+    } \
+    template<class ActionType> \
+    x&& action(ActionType&& action) && \
+    { \
+        add_child(std::forward<ActionType>(action)); \
+        return std::move(*this); \
+    } \
+    x& set_duration(uint32_t duration) & \
+    { \
+        gesture_action_t::set_duration(duration); \
+        return *this; \
+    } \
+    x&& set_duration(uint32_t duration) && \
+    { \
+        gesture_action_t::set_duration(duration); \
+        return std::move(*this); \
+    }
+
+/**
+ * Base class for actions made of other actions.
+ *
+ * All child actions see the same finger state as the group. Unlike the
+ * actions of a gesture, the finger origins are not reset between them.
+ *
+ * The durations of the children are checked against the times of the events
+ * the group receives, so a child times out right before the first event after
+ * its duration. A timeout of the group itself, see set_duration(), is passed
+ * to all running children.
+ */
+class action_group_t : public gesture_action_t
+{
+  public:
+    /** @return The number of child actions. */
+    size_t size() const;
+
+    /** @return The largest history size needed by the children. */
+    size_t get_history_size() const override;
+
+  protected:
+    template<class ActionType>
+    void add_child(ActionType&& action)
+    {
+        using action_type = std::decay_t<ActionType>;
+        if constexpr (is_inline_action_v<action_type>)
+        {
+            children.emplace_back(std::in_place_type<action_type>,
+                std::forward<ActionType>(action));
+        } else
+        {
+            children.emplace_back(std::make_unique<action_type>(
+                std::forward<ActionType>(action)));
+        }
+
+        child_start.push_back(0);
+        child_timed_out.push_back(false);
+    }
+
+    /** Start a child action. */
+    void reset_child(size_t idx, uint32_t time);
+
+    /**
+     * Deliver the timeout of a child if its duration has passed by the time
+     * of the event.
+     *
+     * @return The status of the child after the timeout, or running if it
+     *   has not timed out.
+     */
+    action_status_t expire_child(size_t idx, const gesture_state_t& state,
+        const gesture_event_t& event);
+
+    /**
+     * Run a child action, delivering its timeout first if its duration has
+     * passed.
+     */
+    action_status_t update_child(size_t idx, const gesture_state_t& state,
+        const gesture_event_t& event);
+
+    std::vector<action_storage_t> children;
+    std::vector<uint32_t> child_start;
+
+  private:
+    std::vector<bool> child_timed_out;
+};
+
+/**
+ * An action which completes once all of its children have completed, in any
+ * order. It is cancelled as soon as any child is cancelled.
+ */
+class all_of_action_t : public action_group_t
+{
+  public:
+    WFTOUCH_GROUP_MEMBERS_WITH_CAST(all_of_action_t);
+
+    action_status_t update_state(const gesture_state_t& state,
+        const gesture_event_t& event) override;
+
+    /** The group never completes once one of its running children never does. */
+    bool will_never_complete(const gesture_state_t& state) const override;
+
+    void reset(uint32_t time) override;
+
+  private:
+    std::vector<bool> completed;
+};
+
+/**
+ * An action which completes as soon as any of its children completes. It is
+ * cancelled once all children are cancelled.
+ */
+class any_of_action_t : public action_group_t
+{
+  public:
+    WFTOUCH_GROUP_MEMBERS_WITH_CAST(any_of_action_t);
+
+    action_status_t update_state(const gesture_state_t& state,
+        const gesture_event_t& event) override;
+
+    /** The group never completes once none of its running children does. */
+    bool will_never_complete(const gesture_state_t& state) const override;
+
+    void reset(uint32_t time) override;
+
+  private:
+    std::vector<bool> cancelled;
+};
+
+/**
+ * An action which runs its children in sequence, a given number of times.
+ * For example, a double tap is a touch down and a touch up repeated twice.
+ */
+class repeat_action_t : public action_group_t
+{
+  public:
+    /**
+     * Create a new repeat action.
+     *
+     * @param count The number of times the children need to complete.
+     */
+    repeat_action_t(int count);
+    WFTOUCH_GROUP_MEMBERS_WITH_CAST(repeat_action_t);
+
+    action_status_t update_state(const gesture_state_t& state,
+        const gesture_event_t& event) override;
+
+    /** The group never completes once its current child never does. */
+    bool will_never_complete(const gesture_state_t& state) const override;
+
+    void reset(uint32_t time) override;
+
+  private:
+    int count;
+    int iteration = 0;
+    size_t current = 0;
+};
+
 using gesture_callback_t = std::function<void()>;
 
+/**
+ * The progress of a gesture after an event which did not cancel it.
+ */
+struct gesture_update_t
+{
+    /** The index of the running action, or of the action which completed. */
+    size_t action;
+
+    /** The progress of that action, see gesture_action_t::get_progress(). */
+    double progress;
+
+    /**
+     * The fingers after the event. The values derived from them are cached,
+     * so reading for example the pinch scale does not compute it again.
+     */
+    const gesture_state_t& state;
+};
+
+using gesture_update_callback_t = std::function<void(const gesture_update_t&)>;
+
 class timer_interface_t
 {
   public:
@@ -411,6 +1284,21 @@ class gesture_t
     gesture_t(std::vector<std::unique_ptr<gesture_action_t>> actions = {},
         gesture_callback_t completed = [](){}, gesture_callback_t cancelled = [](){});
 
+    /**
+     * Create a new gesture consisting of the given actions, which may be
+     * stored inline.
+     */
+    gesture_t(std::vector<action_storage_t> actions,
+        gesture_callback_t completed = [](){}, gesture_callback_t cancelled = [](){});
+
+    /**
+     * Create a new gesture consisting of the given actions. The gesture's
+     * state is allocated from the memory resource of the actions, which
+     * needs to outlive the gesture.
+     */
+    gesture_t(std::pmr::vector<action_storage_t> actions,
+        gesture_callback_t completed = [](){}, gesture_callback_t cancelled = [](){});
+
     gesture_t(gesture_t&& other);
     gesture_t& operator=(gesture_t&& other);
 
@@ -426,6 +1314,18 @@ class gesture_t
      */
     void update_state(const gesture_event_t& event);
 
+    /**
+     * Update the gesture state with several consecutive events.
+     *
+     * This is equivalent to calling update_state() for each event, except
+     * that processing stops as soon as the gesture is completed or cancelled.
+     *
+     * @param events The events, in the order they happened.
+     * @param count The number of events.
+     * @return The number of events which were processed.
+     */
+    size_t update_state(const gesture_event_t *events, size_t count);
+
     /**
      * Get the current state of the gesture.
      */
@@ -441,15 +1341,46 @@ class gesture_t
 
     /**
      * Set the timer to use for the gesture.
-     * This needs to be called before using the gesture.
      *
      * In wayfire, this is usually set by core.
+     *
+     * Without a timer, action durations are checked against the times of the
+     * incoming events instead: an action whose duration has passed receives
+     * a timeout event right before the next event. advance_time() delivers
+     * such timeouts when no events arrive.
      */
     void set_timer(std::unique_ptr<timer_interface_t> timer);
 
+    /**
+     * Set a callback to run after each event which updates the current
+     * action without cancelling the gesture, including the event completing
+     * the action. It runs before the completed callback.
+     *
+     * @param callback The callback, or an empty function to remove it.
+     */
+    void set_update_callback(gesture_update_callback_t callback);
+
+    /**
+     * Deliver the timeouts of actions whose durations have passed until the
+     * given time. Only has an effect if the gesture has no timer.
+     *
+     * @param now The current time in milliseconds.
+     */
+    void advance_time(uint32_t now);
+
   private:
     class impl;
-    std::unique_ptr<impl> priv;
+
+    /** Destroys the impl and returns its memory to the resource it came from. */
+    struct impl_deleter_t
+    {
+        std::pmr::memory_resource *resource;
+        void operator ()(impl *priv) const;
+    };
+
+    std::unique_ptr<impl, impl_deleter_t> priv;
+    friend class gesture_set_t;
+    friend class gesture_trie_t;
 };
 
 /**
@@ -458,23 +1389,69 @@ class gesture_t
 class gesture_builder_t
 {
   public:
+    /**
+     * The number of actions the builder has room for before it grows, so
+     * that most gestures allocate their actions once.
+     */
+    static constexpr size_t RESERVED_ACTIONS = 4;
+
     gesture_builder_t();
 
+    /**
+     * Create a builder which allocates the gesture from the given memory
+     * resource, for example gesture_set_t::get_arena(). Custom actions and
+     * the callbacks are still allocated from the heap.
+     *
+     * @param resource The memory resource, which needs to outlive the gesture.
+     */
+    gesture_builder_t(std::pmr::memory_resource *resource);
+
+    /**
+     * Append an action to the gesture. Temporaries are moved instead of
+     * copied.
+     */
     template<class ActionType>
-    gesture_builder_t& action(const ActionType& action)
+    gesture_builder_t& action(ActionType&& action)
+    {
+        return emplace<std::decay_t<ActionType>>(std::forward<ActionType>(action));
+    }
+
+    /**
+     * Construct an action in place at the end of the gesture.
+     *
+     * @param args The arguments to the action's constructor.
+     */
+    template<class ActionType, class... Args>
+    gesture_builder_t& emplace(Args&&... args)
     {
-        actions.push_back(std::make_unique<ActionType>(action));
+        if constexpr (is_inline_action_v<ActionType>)
+        {
+            actions.emplace_back(std::in_place_type<ActionType>, std::forward<Args>(args)...);
+        } else
+        {
+            actions.emplace_back(std::make_unique<ActionType>(std::forward<Args>(args)...));
+        }
+
         return *this;
     }
 
     gesture_builder_t& on_completed(gesture_callback_t callback);
     gesture_builder_t& on_cancelled(gesture_callback_t callback);
+
+    /** See gesture_t::set_update_callback(). */
+    gesture_builder_t& on_update(gesture_update_callback_t callback);
+
+    /**
+     * Create the gesture. The actions and callbacks are moved into it, so
+     * the builder should not be used afterwards.
+     */
     gesture_t build();
 
   private:
     gesture_callback_t _on_completed = [](){};
     gesture_callback_t _on_cancelled = [](){};
-    std::vector<std::unique_ptr<gesture_action_t>> actions;
+    gesture_update_callback_t _on_update;
+    std::pmr::vector<action_storage_t> actions;
 };
 }
 }
@@ -0,0 +1,160 @@
+#pragma once
+
+/**
+ * Recording and replaying of touch event streams.
+ *
+ * A trace file starts with a 12 byte header: the magic "WFTT", a format
+ * version byte, three reserved bytes and the number of subpixel steps per
+ * pixel as a little-endian u32. Each event is then stored as:
+ * - a tag byte: the event type in bits 0-1, and bit 2 set if the event is
+ *   about the same finger as the previous one,
+ * - the time difference to the previous event as an unsigned varint,
+ * - the finger id as a zigzag varint, unless bit 2 of the tag is set,
+ * - for touch events, the x and y coordinates in subpixel steps as zigzag
+ *   varints.
+ *
+ * Timeout events are not recorded. When replaying, they are generated again
+ * by timers driven by a replay_clock_t.
+ */
+#include <wayfire/touch/touch.hpp>
+#include <cstdio>
+#include <string>
+
+namespace wf
+{
+namespace touch
+{
+/**
+ * Writes events to a trace file.
+ */
+class trace_writer_t
+{
+  public:
+    /**
+     * Create a new trace file, overwriting any existing file.
+     *
+     * @param path The path of the file.
+     * @param subpixels The number of steps per pixel positions are rounded to.
+     */
+    trace_writer_t(const std::string& path, uint32_t subpixels = 256);
+    ~trace_writer_t();
+
+    trace_writer_t(const trace_writer_t&) = delete;
+    trace_writer_t& operator =(const trace_writer_t&) = delete;
+
+    /** @return True if the file could be created. */
+    bool is_open() const;
+
+    /** Append an event to the trace. Timeout events are ignored. */
+    void record(const gesture_event_t& event);
+
+    /** Write out buffered events. */
+    void flush();
+
+  private:
+    void put_varint(uint64_t value);
+    void put_zigzag(int64_t value);
+
+    FILE *file = nullptr;
+    double subpixels;
+    std::vector<uint8_t> buffer;
+
+    uint32_t last_time = 0;
+    int32_t last_finger = 0;
+    bool has_last_finger = false;
+};
+
+/**
+ * Reads events from a memory-mapped trace file.
+ * Reading events does not allocate memory.
+ */
+class trace_reader_t
+{
+  public:
+    /** Open and map a trace file. */
+    trace_reader_t(const std::string& path);
+    ~trace_reader_t();
+
+    trace_reader_t(const trace_reader_t&) = delete;
+    trace_reader_t& operator =(const trace_reader_t&) = delete;
+
+    /** @return True if the file was mapped and has a valid header. */
+    bool is_open() const;
+
+    /**
+     * Read the next event.
+     *
+     * @return False at the end of the trace or if the trace is truncated.
+     */
+    bool next(gesture_event_t& event);
+
+    /** Start reading from the first event again. */
+    void rewind();
+
+  private:
+    bool get_varint(uint64_t& value);
+    bool get_zigzag(int64_t& value);
+
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+    double subpixels = 1;
+
+    uint32_t last_time = 0;
+    int32_t last_finger = 0;
+};
+
+/**
+ * A clock driving timers from recorded event times, so that timeouts are
+ * delivered at the same points of a replayed trace every time.
+ */
+class replay_clock_t
+{
+  public:
+    replay_clock_t() = default;
+    replay_clock_t(const replay_clock_t&) = delete;
+    replay_clock_t& operator =(const replay_clock_t&) = delete;
+
+    /**
+     * Create a timer driven by this clock.
+     * The clock needs to outlive the timer.
+     */
+    std::unique_ptr<timer_interface_t> create_timer();
+
+    /**
+     * Advance the clock, running the handlers of all timers which expire
+     * until then, in the order of their expiry.
+     *
+     * The first call only sets the clock, so that traces do not need to start
+     * at time 0. Timers armed before it count from that time.
+     */
+    void advance(uint32_t time);
+
+    /** @return The current time of the clock. */
+    uint32_t now() const;
+
+  private:
+    class timer_t;
+    std::vector<timer_t*> timers;
+    uint32_t current_time = 0;
+    bool started = false;
+};
+
+/**
+ * Replay all remaining events of a trace.
+ *
+ * The clock is advanced to the time of each event before the event is
+ * passed to the handler, which usually updates a gesture or gesture set.
+ */
+template<class Handler>
+void replay_trace(trace_reader_t& reader, replay_clock_t& clock, Handler&& handler)
+{
+    gesture_event_t event;
+    while (reader.next(event))
+    {
+        clock.advance(event.time);
+        handler(event);
+    }
+}
+}
+}